@@ -0,0 +1,454 @@
+// vim: syntax=cpp11:ts=2:sw=2
+//
+// Native microbenchmarks of libshortduid, without V8 in the way. Reports ns/op,
+// heap allocations/op and, on Linux when perf_event is permitted, CPU
+// cycles/op and instructions/op.
+//
+// Usage: shortduid_bench [--json] [--filter <substring>] [--min-time <ms>]
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "generator.h"
+#include "prefetch.h"
+#include "random.h"
+#include "sortable.h"
+#include "hashids.h"
+
+//
+// Heap allocation counting, every operator new in the process goes through here
+//
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if(void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if(void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+  //
+  // Hardware counters, cycles and instructions of the calling thread
+  //
+  class PerfCounters {
+  public:
+    PerfCounters() : cycles_fd_(-1), instructions_fd_(-1) {
+#ifdef __linux__
+      cycles_fd_ = Open(PERF_COUNT_HW_CPU_CYCLES, -1);
+      if(cycles_fd_ >= 0) instructions_fd_ = Open(PERF_COUNT_HW_INSTRUCTIONS, cycles_fd_);
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+      if(instructions_fd_ >= 0) close(instructions_fd_);
+      if(cycles_fd_ >= 0) close(cycles_fd_);
+#endif
+    }
+
+    bool Available() const { return cycles_fd_ >= 0 && instructions_fd_ >= 0; }
+
+    void Start() {
+#ifdef __linux__
+      if(!Available()) return;
+      ioctl(cycles_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(cycles_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    void Stop(uint64_t& cycles, uint64_t& instructions) {
+      cycles = instructions = 0;
+#ifdef __linux__
+      if(!Available()) return;
+      ioctl(cycles_fd_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      if(read(cycles_fd_, &cycles, sizeof(cycles)) != sizeof(cycles)) cycles = 0;
+      if(read(instructions_fd_, &instructions, sizeof(instructions)) != sizeof(instructions)) instructions = 0;
+#endif
+    }
+
+  private:
+#ifdef __linux__
+    static int Open(uint64_t config, int group_fd) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = config;
+      attr.disabled = group_fd < 0 ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+    }
+#endif
+
+    int cycles_fd_;
+    int instructions_fd_;
+  };
+
+  struct Result {
+    std::string name;
+    uint64_t ops;
+    uint32_t threads;
+    double ns_per_op;
+    double allocs_per_op;
+    bool has_counters;
+    double cycles_per_op;
+    double instructions_per_op;
+  };
+
+  struct Options {
+    bool json = false;
+    std::string filter;
+    double min_time_ms = 200;
+  };
+
+  // Keeps results alive so the optimizer can not drop the work
+  volatile uint64_t sink;
+
+  //
+  // Run fn(iterations) with growing iteration count until it takes at least
+  // min_time_ms, fn returns number of operations it did
+  //
+  Result Run(const Options& options, const std::string& name, const std::function<uint64_t(uint64_t)>& fn) {
+    PerfCounters counters;
+    Result result = { name, 0, 1, 0, 0, counters.Available(), 0, 0 };
+
+    fn(1); // Warm up caches and lazy initialization
+    for(uint64_t iterations = 1; ; iterations *= 2) {
+      uint64_t cycles, instructions;
+      uint64_t allocs_before = allocations.load();
+      counters.Start();
+      auto start = std::chrono::steady_clock::now();
+      uint64_t ops = fn(iterations);
+      auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+      counters.Stop(cycles, instructions);
+      uint64_t allocs = allocations.load() - allocs_before;
+
+      if(elapsed >= options.min_time_ms * 1e6 || iterations >= (1ULL << 40)) {
+        result.ops = ops;
+        result.ns_per_op = elapsed / ops;
+        result.allocs_per_op = static_cast<double>(allocs) / ops;
+        result.cycles_per_op = static_cast<double>(cycles) / ops;
+        result.instructions_per_op = static_cast<double>(instructions) / ops;
+        return result;
+      }
+    }
+  }
+
+  //
+  // Same as Run, but fn(iterations) is executed by threads at once, ns/op is
+  // wall time per operation of all threads together
+  //
+  Result RunThreads(const Options& options, const std::string& name, uint32_t threads, const std::function<uint64_t(uint64_t)>& fn) {
+    Result result = { name, 0, threads, 0, 0, false, 0, 0 };
+
+    for(uint64_t iterations = 1; ; iterations *= 2) {
+      std::atomic<uint64_t> ops(0);
+      std::vector<std::thread> pool;
+      uint64_t allocs_before = allocations.load();
+      auto start = std::chrono::steady_clock::now();
+      for(uint32_t t = 0; t < threads; ++t) {
+        pool.emplace_back([&]() { ops.fetch_add(fn(iterations)); });
+      }
+      for(auto& thread : pool) thread.join();
+      auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+      uint64_t allocs = allocations.load() - allocs_before - threads; // std::thread allocates its state
+
+      if(elapsed >= options.min_time_ms * 1e6 || iterations >= (1ULL << 40)) {
+        result.ops = ops.load();
+        result.ns_per_op = elapsed / result.ops;
+        result.allocs_per_op = static_cast<double>(allocs) / result.ops;
+        return result;
+      }
+    }
+  }
+
+  void Print(const Options& options, const std::vector<Result>& results) {
+    if(options.json) {
+      std::printf("{\n  \"benchmarks\": [\n");
+      for(size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::printf("    {\"name\": \"%s\", \"threads\": %u, \"ops\": %llu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f",
+                    r.name.c_str(), r.threads, (unsigned long long) r.ops, r.ns_per_op, r.allocs_per_op);
+        if(r.has_counters) {
+          std::printf(", \"cycles_per_op\": %.2f, \"instructions_per_op\": %.2f", r.cycles_per_op, r.instructions_per_op);
+        } else {
+          std::printf(", \"cycles_per_op\": null, \"instructions_per_op\": null");
+        }
+        std::printf("}%s\n", i + 1 < results.size() ? "," : "");
+      }
+      std::printf("  ]\n}\n");
+      return;
+    }
+
+    std::printf("%-52s %8s %12s %10s %12s %12s\n", "benchmark", "threads", "ns/op", "allocs/op", "cycles/op", "instr/op");
+    for(const Result& r : results) {
+      std::printf("%-52s %8u %12.2f %10.2f", r.name.c_str(), r.threads, r.ns_per_op, r.allocs_per_op);
+      if(r.has_counters) {
+        std::printf(" %12.1f %12.1f\n", r.cycles_per_op, r.instructions_per_op);
+      } else {
+        std::printf(" %12s %12s\n", "-", "-");
+      }
+    }
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  for(int i = 1; i < argc; ++i) {
+    if(!std::strcmp(argv[i], "--json")) {
+      options.json = true;
+    } else if(!std::strcmp(argv[i], "--filter") && i + 1 < argc) {
+      options.filter = argv[++i];
+    } else if(!std::strcmp(argv[i], "--min-time") && i + 1 < argc) {
+      options.min_time_ms = std::atof(argv[++i]);
+    } else {
+      std::fprintf(stderr, "Usage: %s [--json] [--filter <substring>] [--min-time <ms>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<Result> results;
+  auto bench = [&](const std::string& name, const std::function<uint64_t(uint64_t)>& fn) {
+    if(name.find(options.filter) != std::string::npos) results.push_back(Run(options, name, fn));
+  };
+  auto bench_threads = [&](const std::string& name, uint32_t threads, const std::function<uint64_t(uint64_t)>& fn) {
+    if(name.find(options.filter) != std::string::npos) results.push_back(RunThreads(options, name, threads, fn));
+  };
+
+  //
+  // Hashids
+  //
+  const std::pair<const char*, std::string> salts[] = {
+    { "no salt", "" },
+    { "1 char salt", "a" },
+    { "64 char salt", "b130389689f522fa8b6664eb291083551ff0c00a4cf5a4905fdee8cd9063e55a" },
+  };
+  const std::pair<const char*, uint64_t> numbers[] = {
+    { "123", 123ULL },
+    { "2^32", 1ULL << 32 },
+    { "DUID", 12534941854212112ULL },
+    { "UINT64_MAX", UINT64_MAX },
+  };
+
+  for(const auto& salt : salts) {
+    hashidsxx::Hashids hash(salt.second);
+    for(const auto& number : numbers) {
+      std::string suffix = std::string(number.first) + ", " + salt.first;
+      uint64_t value = number.second;
+      std::string encoded = hash.encode_one(value);
+
+      bench("hashids encode " + suffix, [&](uint64_t n) {
+        for(uint64_t i = 0; i < n; ++i) sink = hash.encode({value}).size();
+        return n;
+      });
+      bench("hashids encode_one " + suffix, [&](uint64_t n) {
+        char buf[128];
+        for(uint64_t i = 0; i < n; ++i) sink = hash.encode_one(value, buf);
+        return n;
+      });
+      bench("hashids decode " + suffix, [&](uint64_t n) {
+        for(uint64_t i = 0; i < n; ++i) sink = hash.decode(encoded).size();
+        return n;
+      });
+      bench("hashids decode_one " + suffix, [&](uint64_t n) {
+        uint64_t out;
+        for(uint64_t i = 0; i < n; ++i) sink = hash.decode_one(encoded.data(), encoded.size(), out);
+        return n;
+      });
+    }
+  }
+
+  for(unsigned int min_length : { 16u, 24u, 64u, 1024u }) {
+    // Fixed length slugs: padding rounds come from tables, DUID alone is 11 characters
+    hashidsxx::Hashids hash(salts[2].second, min_length);
+    uint64_t value = 12534941854212112ULL;
+    std::string encoded = hash.encode_one(value);
+    std::vector<char> buf(hash.max_length());
+    std::string suffix = "DUID, min length " + std::to_string(min_length);
+    bench("hashids encode_one " + suffix, [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = hash.encode_one(value, buf.data());
+      return n;
+    });
+    bench("hashids decode_one " + suffix, [&](uint64_t n) {
+      uint64_t out;
+      for(uint64_t i = 0; i < n; ++i) sink = hash.decode_one(encoded.data(), encoded.size(), out);
+      return n;
+    });
+  }
+
+  {
+    // Backfill shape: consecutive DUIDs, one hash each
+    hashidsxx::Hashids hash(salts[2].second);
+    std::vector<uint64_t> values(1024);
+    for(size_t i = 0; i < values.size(); ++i) values[i] = 12534941854212112ULL + i;
+    std::vector<char> out(values.size() * hash.max_length());
+    std::vector<uint32_t> offsets(values.size() + 1);
+    bench("hashids encode_many DUID batch of 1024 (per ID)", [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = hash.encode_many(values.data(), values.size(), out.data(), offsets.data());
+      return n * values.size();
+    });
+
+    size_t encoded_length = hash.encode_many(values.data(), values.size(), out.data(), offsets.data());
+    std::vector<uint64_t> decoded(values.size());
+    std::vector<uint8_t> valid((values.size() + 7) / 8);
+    bench("hashids decode_many DUID batch of 1024 (per ID)", [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = hash.decode_many(out.data(), encoded_length, offsets.data(), values.size(), decoded.data(), valid.data());
+      return n * values.size();
+    });
+  }
+
+  //
+  // Sortable keys
+  //
+  for(auto alphabet : { shortduid::SortableCodec::BASE62, shortduid::SortableCodec::BASE64URL }) {
+    for(const char* key : { "", "secret" }) {
+      shortduid::SortableCodec sortable(alphabet, key);
+      std::string suffix = std::string(alphabet == shortduid::SortableCodec::BASE62 ? "base62" : "base64url") + (*key ? " keyed" : "");
+      std::vector<uint64_t> values(1024);
+      for(size_t i = 0; i < values.size(); ++i) values[i] = 12534941854212112ULL + i;
+      std::vector<char> out(values.size() * shortduid::SortableCodec::WIDTH);
+      bench("sortable EncodeMany 1024 (per ID), " + suffix, [&](uint64_t n) {
+        for(uint64_t i = 0; i < n; ++i) sink = sortable.EncodeMany(values.data(), values.size(), out.data());
+        return n * values.size();
+      });
+      std::vector<uint64_t> decoded(values.size());
+      std::vector<uint8_t> valid((values.size() + 7) / 8);
+      bench("sortable DecodeMany 1024 (per ID), " + suffix, [&](uint64_t n) {
+        for(uint64_t i = 0; i < n; ++i) sink = sortable.DecodeMany(out.data(), out.size(), -1, decoded.data(), valid.data());
+        return n * values.size();
+      });
+    }
+  }
+
+  //
+  // Generator
+  //
+  shortduid::Generator generator(0, 1433116800000ULL);
+  bench("GetUniqueID", [&](uint64_t n) {
+    for(uint64_t i = 0; i < n; ++i) sink = generator.GetUniqueID();
+    return n;
+  });
+  {
+    shortduid::Generator coarse(3, 1433116800000ULL), ticker(4, 1433116800000ULL);
+    coarse.SetTimeSource(shortduid::Generator::COARSE_CLOCK);
+    ticker.SetTimeSource(shortduid::Generator::TICKER_CLOCK);
+    bench("GetUniqueID coarse clock", [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = coarse.GetUniqueID();
+      return n;
+    });
+    bench("GetUniqueID ticker clock", [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = ticker.GetUniqueID();
+      return n;
+    });
+  }
+  {
+    shortduid::Generator wide_sequence(6, 1433116800000ULL, shortduid::Generator::LAYOUT_41_8_15);
+    bench("GetUniqueID layout 41/8/15", [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = wide_sequence.GetUniqueID();
+      return n;
+    });
+  }
+  for(size_t batch : { 10, 1024, 4096 }) {
+    std::vector<uint64_t> ids(batch);
+    bench("GetUniqueIDs batch of " + std::to_string(batch) + " (per ID)", [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) generator.GetUniqueIDs(ids.data(), batch);
+      sink = ids.back();
+      return n * batch;
+    });
+  }
+
+  uint32_t cores = std::max(2U, std::thread::hardware_concurrency());
+  for(uint32_t threads = 2; threads <= cores; threads *= 2) {
+    bench_threads("GetUniqueID contended", threads, [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = generator.GetUniqueID();
+      return n;
+    });
+  }
+
+  {
+    shortduid::Generator persisted(2, 1433116800000ULL);
+    std::remove("shortduid_bench.hwm");
+    persisted.EnableHighWaterMark("shortduid_bench.hwm", 10000);
+    bench("GetUniqueID with high-water mark", [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = persisted.GetUniqueID();
+      return n;
+    });
+    std::remove("shortduid_bench.hwm");
+  }
+
+  auto shared = shortduid::Generator::Shared(1, 1433116800000ULL);
+  bench("GetUniqueID shared", [&](uint64_t n) {
+    for(uint64_t i = 0; i < n; ++i) sink = shared->GetUniqueID();
+    return n;
+  });
+  for(uint32_t threads = 2; threads <= cores; threads *= 2) {
+    bench_threads("GetUniqueID shared, leased per thread", threads, [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = shared->GetUniqueID();
+      return n;
+    });
+  }
+
+  {
+    // Served encoded, what getDUID costs with and without the ring
+    hashidsxx::Hashids hash(salts[2].second);
+    auto own = std::make_shared<shortduid::Generator>(5, 1433116800000ULL);
+    std::vector<char> buf(hash.max_length());
+    bench("GetUniqueID + encode_one", [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) sink = hash.encode_one(own->GetUniqueID(), buf.data());
+      return n;
+    });
+    shortduid::Prefetcher prefetch(own, hash);
+    uint32_t length;
+    bench("Prefetcher Take", [&](uint64_t n) {
+      for(uint64_t i = 0; i < n; ++i) prefetch.Take(1, buf.data(), &length);
+      sink = length;
+      return n;
+    });
+  }
+
+  //
+  // Random strings
+  //
+  bench("GetRandomString 64 chars URL safe", [&](uint64_t n) {
+    for(uint64_t i = 0; i < n; ++i) sink = shortduid::GetRandomString(64, shortduid::URLSAFE_ALPHABET).size();
+    return n;
+  });
+  bench("GetRandomString 16 chars password", [&](uint64_t n) {
+    for(uint64_t i = 0; i < n; ++i) sink = shortduid::GetRandomString(16, shortduid::PASSWORD_ALPHABET).size();
+    return n;
+  });
+
+  Print(options, results);
+  return 0;
+}
@@ -6,16 +6,36 @@
       'sources': [
         'src/main.cpp',
         'src/shortduid.cpp',
+        'core/generator.cpp',
+        'core/prefetch.cpp',
+        'core/random.cpp',
+        'core/shared_segment.cpp',
+        'core/sortable.cpp',
+        'core/ticker.cpp',
         'hashids/hashids.cpp',
       ],
+      'include_dirs': [
+        'core',
+        'hashids',
+      ],
+      'defines': [
+        'NAPI_VERSION=6',
+      ],
       'cflags': [
         '-std=c++11'
       ],
+      # Core reports configuration and system errors as exceptions, the binding turns them into JS errors
+      'cflags!': ['-fno-exceptions'],
+      'cflags_cc!': ['-fno-exceptions'],
       'conditions': [
+        [ 'OS=="linux"', {
+          'libraries': ['-lrt'],
+        }],
         [ 'OS=="mac"', {
           "xcode_settings": {
             'OTHER_CPLUSPLUSFLAGS' : ['-std=c++11','-stdlib=libc++'],
             'OTHER_LDFLAGS': ['-stdlib=libc++'],
+            'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
             'MACOSX_DEPLOYMENT_TARGET': '10.9'
           }
         }],
@@ -0,0 +1,399 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#include "generator.h"
+#include "shared_segment.h"
+#include "ticker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+namespace shortduid {
+
+  namespace {
+
+    //
+    // Block of (timestamp << sequence bits | sequence) values of one shared generator leased by a thread, [next, end)
+    //
+    const uint64_t MAX_LEASE = 1024; // Capped at a quarter of the sequence space, see LeaseCap
+    struct Lease {
+      uint64_t owner;
+      uint64_t next;
+      uint64_t end;
+      uint64_t size;
+    };
+
+    thread_local Lease lease = { 0, 0, 0, 1 }; // Constant initialized, no TLS guard on every call
+
+    // Four busy threads fill a millisecond before anyone borrows from the next
+    template<class L> uint64_t LeaseCap() {
+      return std::min<uint64_t>(MAX_LEASE, (L::SEQUENCE_MASK + 1) / 4);
+    }
+
+    template<class L> void ParseColumns(const uint64_t* ids, size_t cnt, uint64_t epoch_start, uint64_t* timestamps_ms, uint32_t* shard_ids, uint32_t* sequences) {
+      // Separate passes keep every loop branch free and vectorizable
+      if(timestamps_ms) for(size_t i = 0; i < cnt; ++i) timestamps_ms[i] = L::Timestamp(ids[i]) + epoch_start;
+      if(shard_ids) for(size_t i = 0; i < cnt; ++i) shard_ids[i] = (uint32_t) L::Shard(ids[i]);
+      if(sequences) for(size_t i = 0; i < cnt; ++i) sequences[i] = (uint32_t) L::Sequence(ids[i]);
+    }
+
+#ifndef _WIN32
+    // Forked child must not hand out what is left of the parent's lease, the state it came from may be shared memory.
+    // Only the forking thread lives on in the child, its lease is the one to drop
+    void OnFork() {
+      lease.owner = 0;
+    }
+
+    std::once_flag fork_handler_once;
+#endif
+
+  }  // namespace
+
+  Generator::Generator(const uint32_t shard_id, const uint64_t epoch_start, const Layout layout) : epoch_start_(epoch_start), layout_(layout), leased_(false) {
+    switch(layout) {
+      case LAYOUT_42_10_12:
+        generate_ = &Generator::Generate<Layout42_10_12>;
+        break;
+      case LAYOUT_41_8_15:
+        generate_ = &Generator::Generate<Layout41_8_15>;
+        break;
+      case LAYOUT_40_14_10:
+        generate_ = &Generator::Generate<Layout40_14_10>;
+        break;
+      default:
+        throw std::invalid_argument("unknown ID layout " + std::to_string(TimestampBits(layout)) + "/" + std::to_string(ShardBits(layout)) + "/" + std::to_string(SequenceBits(layout)));
+    }
+    shard_id_ = shard_id & ((1UL << ShardBits(layout)) - 1);
+    static std::atomic<uint64_t> next_id(1); // 0 is never issued, fresh thread leases belong to nobody
+    id_ = next_id.fetch_add(1, std::memory_order_relaxed);
+    time_offset_ = 0; // Mainly used in tests, applied to the time before ID is generated
+    own_state_ = 0ULL; // Last used timestamp and sub-millisecond sequence
+    state_ = &own_state_;
+    last_clock_ms_ = 0ULL;
+    max_drift_ms_ = 0ULL;
+    extend_at_ms_ = UINT64_MAX;
+    persisted_ms_ = 0ULL;
+    high_water_lease_ms_ = 0ULL;
+    time_source_ = STEADY_CLOCK;
+    stats_baseline_ = Stats();
+
+    //Setup time related variables
+    auto mono_time = Ticker::SteadyMs();
+    system_time_at_start_ = (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    // In case steady clock do not show same time as system clock
+    mono_epoch_diff_ = system_time_at_start_ - mono_time;
+
+    //Check to see if custom epoch does not overflow current time and reset it to 0 if it does
+    if(epoch_start_ > system_time_at_start_) {
+      epoch_start_ = 0ULL;
+    }
+  }
+
+  Generator::~Generator() {
+  }
+
+  std::shared_ptr<Generator> Generator::Shared(const uint32_t shard_id, const uint64_t epoch_start, const std::string& segment, const Layout layout) {
+    // Never destroyed, node.js environments may let go of their generators after static destructors ran
+    static auto registry_mutex = new std::mutex();
+    static auto registry = new std::map<std::tuple<uint32_t, uint64_t, std::string, uint32_t>, std::weak_ptr<Generator>>();
+#ifndef _WIN32
+    std::call_once(fork_handler_once, []() { pthread_atfork(nullptr, nullptr, OnFork); });
+#endif
+
+    std::lock_guard<std::mutex> lock(*registry_mutex);
+    auto generator = std::make_shared<Generator>(shard_id, epoch_start, layout); // Validates layout before anything is registered
+    auto& entry = (*registry)[std::make_tuple(generator->shard_id_, epoch_start, segment, (uint32_t) layout)];
+    if(auto existing = entry.lock()) {
+      generator = existing;
+    } else {
+      generator->leased_ = true;
+      if(!segment.empty()) {
+        generator->segment_.reset(new SharedSegment(segment, layout, generator->shard_id_, generator->epoch_start_));
+        generator->state_ = &generator->segment_->State();
+      }
+      entry = generator;
+    }
+    return generator;
+  }
+
+  void Generator::EnableHighWaterMark(const std::string& path, uint64_t lease_ms) {
+    std::lock_guard<std::mutex> lock(high_water_mutex_);
+    if(high_water_) {
+      if(high_water_->GetName() == path) return;
+      throw std::runtime_error("high-water mark already kept in " + high_water_->GetName());
+    }
+
+    std::unique_ptr<SharedSegment> high_water(new SharedSegment(path, layout_, shard_id_, epoch_start_, SharedSegment::MAPPED_FILE));
+
+    // Resume strictly above the mark: state says last handed out ID is the final one of the marked millisecond
+    uint64_t mark = high_water->State().load(std::memory_order_acquire);
+    uint64_t floor = ((mark + 1) << SequenceBits(layout_)) - 1;
+    uint64_t state = state_->load(std::memory_order_relaxed);
+    while(state < floor && !state_->compare_exchange_weak(state, floor, std::memory_order_relaxed));
+
+    high_water_lease_ms_ = std::max<uint64_t>(lease_ms, 2);
+    persisted_ms_.store(mark, std::memory_order_relaxed);
+    high_water_ = std::move(high_water);
+    extend_at_ms_.store(0, std::memory_order_release); // First ID extends it
+  }
+
+  void Generator::ExtendHighWaterMark(uint64_t last_ms) {
+    // IDs up to the durable mark can go out while another thread extends it, beyond it they have to wait for the disk
+    std::unique_lock<std::mutex> lock(high_water_mutex_, std::defer_lock);
+    if(last_ms <= persisted_ms_.load(std::memory_order_acquire)) {
+      if(!lock.try_lock()) return;
+    } else {
+      lock.lock();
+    }
+    if(last_ms < extend_at_ms_.load(std::memory_order_relaxed)) return; // Extended while we waited
+
+    // Other processes may share the file, mark only grows
+    auto& word = high_water_->State();
+    uint64_t mark = last_ms + high_water_lease_ms_;
+    uint64_t current = word.load(std::memory_order_relaxed);
+    while(current < mark && !word.compare_exchange_weak(current, mark, std::memory_order_relaxed));
+    mark = std::max(mark, current);
+    // On I/O error the mark still holds for restarts without power loss, nothing better to do from here
+    high_water_->Sync();
+
+    persisted_ms_.store(mark, std::memory_order_release);
+    extend_at_ms_.store(mark - high_water_lease_ms_ / 2, std::memory_order_release);
+  }
+
+  void Generator::SetTimeSource(TimeSource source) {
+    std::lock_guard<std::mutex> lock(time_source_mutex_);
+    // Ticker runs before anyone reads it and is let go only after nobody does any more
+    if(source == TICKER_CLOCK && !ticker_) ticker_ = Ticker::Acquire();
+    time_source_.store(source, std::memory_order_relaxed);
+    if(source != TICKER_CLOCK) ticker_.reset();
+  }
+
+  uint64_t Generator::GetCurrentTimeMs() const {
+    switch(time_source_.load(std::memory_order_relaxed)) {
+      case TICKER_CLOCK:
+        return mono_epoch_diff_ + Ticker::Now();
+      case COARSE_CLOCK:
+        return mono_epoch_diff_ + Ticker::CoarseMs();
+      default:
+        return mono_epoch_diff_ + Ticker::SteadyMs();
+    }
+  }
+
+  uint64_t Generator::GetMillisecondsSinceThisEpoch() const {
+    // Create milliseconds since custom epoch, we want those numbers short
+    uint64_t milliseconds_since_this_epoch = GetCurrentTimeMs() - (epoch_start_ + time_offset_);
+    return milliseconds_since_this_epoch & ((1ULL << TimestampBits(layout_)) - 1); // Overflow if not fitting timestamp bits
+  }
+
+  template<class L> uint64_t Generator::MillisecondsSinceThisEpoch() const {
+    return (GetCurrentTimeMs() - (epoch_start_ + time_offset_)) & L::TIMESTAMP_MASK;
+  }
+
+  Generator::Parts Generator::Parse(uint64_t id) const {
+    unsigned sequence_bits = SequenceBits(layout_), shard_bits = ShardBits(layout_);
+    Parts parts;
+    parts.timestamp_ms = (id >> (shard_bits + sequence_bits)) + epoch_start_;
+    parts.shard_id = (uint32_t) ((id >> sequence_bits) & ((1ULL << shard_bits) - 1));
+    parts.sequence = (uint32_t) (id & ((1ULL << sequence_bits) - 1));
+    return parts;
+  }
+
+  void Generator::ParseMany(const uint64_t* ids, size_t cnt, uint64_t* timestamps_ms, uint32_t* shard_ids, uint32_t* sequences) const {
+    switch(layout_) {
+      case LAYOUT_41_8_15:
+        return ParseColumns<Layout41_8_15>(ids, cnt, epoch_start_, timestamps_ms, shard_ids, sequences);
+      case LAYOUT_40_14_10:
+        return ParseColumns<Layout40_14_10>(ids, cnt, epoch_start_, timestamps_ms, shard_ids, sequences);
+      default:
+        return ParseColumns<Layout42_10_12>(ids, cnt, epoch_start_, timestamps_ms, shard_ids, sequences);
+    }
+  }
+
+  uint64_t Generator::MinIdForTime(uint64_t unix_ms) const {
+    if(unix_ms <= epoch_start_) return 0;
+    uint64_t ms = std::min<uint64_t>(unix_ms - epoch_start_, (1ULL << TimestampBits(layout_)) - 1);
+    return ms << (ShardBits(layout_) + SequenceBits(layout_));
+  }
+
+  uint64_t Generator::MaxIdForTime(uint64_t unix_ms) const {
+    unsigned shift = ShardBits(layout_) + SequenceBits(layout_);
+    if(unix_ms < epoch_start_) return (1ULL << shift) - 1; // Clamps to the first millisecond of the epoch
+    uint64_t ms = std::min<uint64_t>(unix_ms - epoch_start_, (1ULL << TimestampBits(layout_)) - 1);
+    return (ms << shift) | ((1ULL << shift) - 1);
+  }
+
+  Generator::Stats Generator::GetStats(bool reset) {
+    Stats stats = {};
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      for(auto& entry : stats_blocks_) {
+        stats.ids_issued += entry.second->ids_issued.load(std::memory_order_relaxed);
+        stats.sequence_overflows += entry.second->sequence_overflows.load(std::memory_order_relaxed);
+        stats.clock_regressions += entry.second->clock_regressions.load(std::memory_order_relaxed);
+      }
+      Stats totals = stats;
+      stats.ids_issued -= stats_baseline_.ids_issued;
+      stats.sequence_overflows -= stats_baseline_.sequence_overflows;
+      stats.clock_regressions -= stats_baseline_.clock_regressions;
+      if(reset) stats_baseline_ = totals;
+    }
+    stats.max_drift_ms = reset ? max_drift_ms_.exchange(0, std::memory_order_relaxed) : max_drift_ms_.load(std::memory_order_relaxed);
+    stats.current_drift_ms = GetDriftMs();
+
+    return stats;
+  }
+
+  uint64_t Generator::GetDriftMs() const {
+    uint64_t last_ms = state_->load(std::memory_order_relaxed) >> SequenceBits(layout_);
+    uint64_t now = GetMillisecondsSinceThisEpoch();
+    return (last_ms > now) ? last_ms - now : 0;
+  }
+
+  uint64_t Generator::GetSequenceBudget() const {
+    unsigned sequence_bits = SequenceBits(layout_);
+    uint64_t state = state_->load(std::memory_order_relaxed);
+    uint64_t now = GetMillisecondsSinceThisEpoch();
+    uint64_t last_ms = state >> sequence_bits;
+    if(last_ms < now) return 1ULL << sequence_bits; // Fresh millisecond
+    if(last_ms > now) return 0;
+    uint64_t mask = (1ULL << sequence_bits) - 1;
+    return mask - (state & mask);
+  }
+
+  Generator::StatsBlock* Generator::RegisterStatsBlock() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    auto& block = stats_blocks_[std::this_thread::get_id()];
+    if(!block) {
+      block.reset(new StatsBlock());
+      block->ids_issued = 0ULL;
+      block->sequence_overflows = 0ULL;
+      block->clock_regressions = 0ULL;
+    }
+    return block.get();
+  }
+
+  void Generator::UpdateStats(uint64_t cnt, uint64_t overflows, bool regression, uint64_t drift) {
+    // Blocks of the last few generators this thread used, by generator id like leases. Ids are never reused, so the
+    // block of a destroyed generator is never looked at again. Constant initialized, no TLS guard on every call
+    struct Slot {
+      uint64_t owner;
+      StatsBlock* block;
+    };
+    static thread_local Slot slots[4] = {};
+    Slot& slot = slots[id_ % 4];
+    if(slot.owner != id_) {
+      slot.block = RegisterStatsBlock();
+      slot.owner = id_;
+    }
+    StatsBlock& block = *slot.block;
+
+    // Single writer, readers only sum up
+    if(cnt) block.ids_issued.store(block.ids_issued.load(std::memory_order_relaxed) + cnt, std::memory_order_relaxed);
+    if(overflows) block.sequence_overflows.store(block.sequence_overflows.load(std::memory_order_relaxed) + overflows, std::memory_order_relaxed);
+    if(regression) block.clock_regressions.store(block.clock_regressions.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if(drift == 0) return;
+    uint64_t max_drift = max_drift_ms_.load(std::memory_order_relaxed);
+    while(drift > max_drift && !max_drift_ms_.compare_exchange_weak(max_drift, drift, std::memory_order_relaxed));
+  }
+
+  uint64_t Generator::GetUniqueID() {
+    // Generate distributed-safe unique ID based on milliseconds timestanp, sequence, and shard id
+    // With default layout 42 bits (not bytes) are for milliseconds, should fit 139 years of milliseconds
+    // 10 bits for shard ID, 2^10 shards (1024)
+    // 12 bits for atomic sequence, 2^12 unique numbers per millisecond (4096)
+    uint64_t id;
+    (this->*generate_)(&id, 1, true);
+    return id;
+  }
+
+  void Generator::GetUniqueIDs(uint64_t* ids, size_t cnt) {
+    (this->*generate_)(ids, cnt, true);
+  }
+
+  void Generator::ReserveUniqueIDs(uint64_t* ids, size_t cnt) {
+    (this->*generate_)(ids, cnt, false);
+  }
+
+  template<class L> void Generator::Generate(uint64_t* ids, size_t cnt, bool issued) {
+    // Claim cnt consecutive (timestamp, sequence) pairs, from the thread's lease or with single CAS on the packed
+    // generator state. Clock is read once per batch, whole batch is filled with shift-and-or afterwards.
+    if(cnt == 0) return;
+
+    // Get fresh milli time since this epoch from monotonic clock
+    uint64_t milliseconds_since_this_epoch = MillisecondsSinceThisEpoch<L>();
+
+    // Keep track of newest clock reading, moves once per millisecond so CAS is rare
+    uint64_t last_clock = last_clock_ms_.load(std::memory_order_relaxed);
+    bool regression = milliseconds_since_this_epoch < last_clock;
+    if(milliseconds_since_this_epoch > last_clock) {
+      last_clock_ms_.compare_exchange_strong(last_clock, milliseconds_since_this_epoch, std::memory_order_relaxed);
+    }
+
+    uint64_t overflows;
+    uint64_t first = leased_ ? ClaimLeased<L>(cnt, milliseconds_since_this_epoch, overflows) : Claim<L>(cnt, milliseconds_since_this_epoch, overflows);
+
+    uint64_t last_ms = (first + cnt - 1) >> L::SEQUENCE_BITS;
+    if(last_ms >= extend_at_ms_.load(std::memory_order_acquire)) ExtendHighWaterMark(last_ms);
+    UpdateStats(issued ? cnt : 0, overflows, regression, (last_ms > milliseconds_since_this_epoch) ? last_ms - milliseconds_since_this_epoch : 0);
+
+    // Pack IDs
+    uint64_t shard = shard_id_;
+    for(size_t i = 0; i < cnt; ++i) {
+      ids[i] = L::Pack(first + i, shard);
+    }
+  }
+
+  template<class L> uint64_t Generator::Claim(uint64_t cnt, uint64_t milliseconds_since_this_epoch, uint64_t& overflows) {
+    // State is the last handed out (timestamp << sequence bits | sequence). Fresh millisecond starts at sequence 0,
+    // otherwise we continue after the last one; adding past the last sequence carries into the timestamp, which is how
+    // we borrow from the next millisecond on overflow and why IDs stay monotonic even if the clock goes backwards.
+    uint64_t state = state_->load(std::memory_order_relaxed);
+    uint64_t first;
+    bool fresh;
+    do {
+      fresh = milliseconds_since_this_epoch > (state >> L::SEQUENCE_BITS);
+      first = fresh ? (milliseconds_since_this_epoch << L::SEQUENCE_BITS) : state + 1;
+    } while(!state_->compare_exchange_weak(state, first + cnt - 1, std::memory_order_relaxed));
+
+    // Every millisecond boundary crossed without the clock getting there is an overflow
+    overflows = ((first + cnt - 1) >> L::SEQUENCE_BITS) - ((fresh ? first : state) >> L::SEQUENCE_BITS);
+    return first;
+  }
+
+  template<class L> uint64_t Generator::ClaimLeased(uint64_t cnt, uint64_t milliseconds_since_this_epoch, uint64_t& overflows) {
+    // Lease of this thread serves as long as it has room and its timestamps have not fallen behind the clock. Leases
+    // come out of the same state as plain claims, so a thread running dry simply claims again and the carry into the
+    // next millisecond still does the borrowing once the whole sequence space of this one is handed out.
+    if(lease.owner == id_ && (lease.next >> L::SEQUENCE_BITS) >= milliseconds_since_this_epoch && lease.end - lease.next >= cnt) {
+      overflows = 0; // Counted when the lease was claimed
+      uint64_t first = lease.next;
+      lease.next += cnt;
+      return first;
+    }
+
+    // Lease ran dry within its millisecond: busy thread, double the next one. Clock left a lease half used: halve it
+    if(lease.owner != id_) {
+      lease.size = 1;
+    } else if(((lease.end - 1) >> L::SEQUENCE_BITS) >= milliseconds_since_this_epoch) {
+      lease.size = std::min(lease.size * 2, LeaseCap<L>());
+    } else if(lease.next != lease.end) {
+      lease.size = std::max<uint64_t>(lease.size / 2, 1);
+    }
+
+    uint64_t block = std::max(cnt, lease.size);
+    uint64_t first = Claim<L>(block, milliseconds_since_this_epoch, overflows);
+    lease.owner = id_;
+    lease.next = first + cnt;
+    lease.end = first + block;
+    return first;
+  }
+
+}  // namespace shortduid
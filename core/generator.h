@@ -0,0 +1,227 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#ifndef SHORTDUID_GENERATOR_H
+#define SHORTDUID_GENERATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "layout.h"
+
+namespace shortduid {
+
+  class SharedSegment;
+  class Ticker;
+
+  //
+  // Distributed unique ID generator, no node.js/V8 dependency. Thread safe, all
+  // state lives in one atomic word.
+  //
+  // ID layout, 42/10/12 unless another one is picked at construction, see core/layout.h:
+  // | timestamp_ms | shard_id | sequence |
+  // |    42bit     |  10bit   |  12bit   |
+  //
+  // Shared() generators are meant to be used by many threads at once: every
+  // thread leases a block of the sequence space and hands out IDs from it without
+  // touching shared state, only refills go through the atomic word. Given a
+  // segment name that word lives in shared memory and is shared by processes too.
+  //
+  class Generator {
+  public:
+    //
+    // Counters since creation or last reset, IDs are counted as they are handed out
+    //
+    struct Stats {
+      uint64_t ids_issued;          // IDs handed out
+      uint64_t sequence_overflows;  // Times sequence space of a millisecond ran out and next one was borrowed
+      uint64_t clock_regressions;   // Clock readings older than the newest one seen before
+      uint64_t max_drift_ms;        // Largest distance of handed out timestamp ahead of clock
+      uint64_t current_drift_ms;    // Distance of last handed out timestamp ahead of clock right now
+    };
+
+    //
+    // Parts of an ID, timestamp in milliseconds since unix epoch
+    //
+    struct Parts {
+      uint64_t timestamp_ms;
+      uint32_t shard_id;
+      uint32_t sequence;
+    };
+
+    //
+    // Pre-instantiated layouts, values are BitLayout<>::ID
+    //
+    enum Layout {
+      LAYOUT_42_10_12 = Layout42_10_12::ID,
+      LAYOUT_41_8_15 = Layout41_8_15::ID,
+      LAYOUT_40_14_10 = Layout40_14_10::ID
+    };
+
+    //
+    // shard_id is masked to the shard bits of layout. Throws std::invalid_argument for a layout not listed above.
+    //
+    explicit Generator(uint32_t shard_id = 0, uint64_t epoch_start = 0, Layout layout = LAYOUT_42_10_12);
+
+    ~Generator();
+
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+
+    //
+    // Process wide generator of shard_id and epoch_start, every caller gets the same one while any reference is alive.
+    // IDs are unique across all threads and monotonic within each thread, but not across threads. With segment, state
+    // is kept in that POSIX shared memory segment and IDs are unique across all processes of the host using it; throws
+    // std::runtime_error if it can not be used, see core/shared_segment.h.
+    //
+    static std::shared_ptr<Generator> Shared(uint32_t shard_id = 0, uint64_t epoch_start = 0, const std::string& segment = "", Layout layout = LAYOUT_42_10_12);
+    bool IsShared() const { return leased_; }
+
+    //
+    // Keep a high-water mark of handed out timestamps in file at path, so IDs after a restart, even one following the
+    // clock being stepped back, resume strictly above anything handed out before. The mark is reserved lease_ms ahead
+    // and written out (msync) again halfway through, so only a call crossing it now and then waits for the disk. Call
+    // before handing out IDs; again with the same path is a no-op. Throws std::runtime_error if the file can not be
+    // used or another path is already in use.
+    //
+    void EnableHighWaterMark(const std::string& path, uint64_t lease_ms = 10000);
+
+    //
+    // ID generation
+    //
+    uint64_t GetUniqueID();
+    void GetUniqueIDs(uint64_t* ids, size_t cnt);
+
+    //
+    // Same as GetUniqueIDs() for IDs generated ahead of handing them out, e.g. into a prefetch ring: not counted as
+    // issued until whoever hands them out calls CountIssued(), so the ones never handed out are not counted at all
+    //
+    void ReserveUniqueIDs(uint64_t* ids, size_t cnt);
+    void CountIssued(uint64_t cnt) { UpdateStats(cnt, 0, false, 0); }
+
+    //
+    // Introspection following layout and epoch start of this generator. ParseMany fills columns, any may be null.
+    // ID bounds cover every shard and sequence of the millisecond, times outside the layout's range clamp to its ends.
+    //
+    Parts Parse(uint64_t id) const;
+    void ParseMany(const uint64_t* ids, size_t cnt, uint64_t* timestamps_ms, uint32_t* shard_ids, uint32_t* sequences) const;
+    uint64_t MinIdForTime(uint64_t unix_ms) const;
+    uint64_t MaxIdForTime(uint64_t unix_ms) const;
+
+    //
+    // Settings
+    //
+    uint32_t GetShardID() const { return shard_id_; }
+    uint64_t GetEpochStart() const { return epoch_start_; }
+    Layout GetLayout() const { return layout_; }
+
+    //
+    // Instrumentation, reset clears counters after taking the snapshot without losing concurrent updates
+    //
+    Stats GetStats(bool reset = false);
+    void ResetStats() { GetStats(true); }
+
+    //
+    // Cheap reads of the state alone, no counters: Stats::current_drift_ms, and how many IDs fit the sequence space of
+    // the current millisecond before generating borrows from the next one (0 while drifting). For a shared generator
+    // other threads' leases may take what the budget shows.
+    //
+    uint64_t GetDriftMs() const;
+    uint64_t GetSequenceBudget() const;
+
+    //
+    // Where the monotonic milliseconds come from, all share the steady clock's base:
+    //  STEADY_CLOCK  steady clock read per call, default
+    //  COARSE_CLOCK  CLOCK_MONOTONIC_COARSE, no hardware access but only as fine as the kernel tick (1-4 ms) and behind
+    //                the steady clock by up to that much; steady clock where not available
+    //  TICKER_CLOCK  plain load of what the process wide ticker thread publishes every millisecond, checked against the
+    //                steady clock only when it stops moving, see core/ticker.h
+    // Applies to every user of a shared generator.
+    //
+    enum TimeSource {
+      STEADY_CLOCK,
+      COARSE_CLOCK,
+      TICKER_CLOCK
+    };
+
+    void SetTimeSource(TimeSource source);
+    TimeSource GetTimeSource() const { return static_cast<TimeSource>(time_source_.load(std::memory_order_relaxed)); }
+
+    //
+    // Time as seen by generator, milliseconds since unix epoch not adjusted for custom epoch
+    //
+    uint64_t GetCurrentTimeMs() const;
+
+    //
+    // Timestamp part of an ID generated now, milliseconds since custom epoch
+    //
+    uint64_t GetMillisecondsSinceThisEpoch() const;
+
+    //
+    // Only should be used for unit testing, simulates clock drift
+    //
+    void SetTimeOffset(int64_t time_offset) { time_offset_ = time_offset; }
+    int64_t GetTimeOffset() const { return time_offset_; }
+
+  private:
+    //
+    // Every thread counts into a block of its own with plain loads and stores, nobody else writes it. Blocks are
+    // registered the first time a thread gets here, outlive their thread and are summed up only when read; reset moves
+    // the baseline instead of touching counters other threads keep writing. new of C++11 does not honour alignas, so
+    // padding on both sides keeps the counters off cache lines of neighbouring allocations.
+    //
+    struct StatsBlock {
+      char padding_before[64];
+      std::atomic<uint64_t> ids_issued;
+      std::atomic<uint64_t> sequence_overflows;
+      std::atomic<uint64_t> clock_regressions;
+      char padding_after[64];
+    };
+
+    //
+    // Hot path, instantiated for every layout; the one of this generator is picked at construction
+    //
+    template<class L> void Generate(uint64_t* ids, size_t cnt, bool issued);
+    template<class L> uint64_t Claim(uint64_t cnt, uint64_t milliseconds_since_this_epoch, uint64_t& overflows);
+    template<class L> uint64_t ClaimLeased(uint64_t cnt, uint64_t milliseconds_since_this_epoch, uint64_t& overflows);
+    template<class L> uint64_t MillisecondsSinceThisEpoch() const;
+    void ExtendHighWaterMark(uint64_t last_ms);
+    void UpdateStats(uint64_t cnt, uint64_t overflows, bool regression, uint64_t drift);
+    StatsBlock* RegisterStatsBlock();
+
+    std::atomic<uint64_t> own_state_;
+    std::atomic<uint64_t>* state_; // (timestamp << sequence bits) | sequence of last handed out ID, own_state_ or in segment_
+    std::atomic<uint64_t> last_clock_ms_; // Newest clock reading, to notice regressions
+    std::atomic<uint64_t> max_drift_ms_;
+    std::mutex stats_mutex_;
+    std::map<std::thread::id, std::unique_ptr<StatsBlock>> stats_blocks_; // Thread ids are reused, so are their blocks
+    Stats stats_baseline_; // Sums at last reset
+    uint64_t system_time_at_start_;
+    uint64_t mono_epoch_diff_;
+    uint64_t epoch_start_;
+    uint32_t shard_id_;
+    Layout layout_;               // Recorded in shared memory segments and high-water mark files
+    void (Generator::*generate_)(uint64_t* ids, size_t cnt, bool issued); // Generate<> of layout_
+    int64_t time_offset_;         //For testing only
+    uint64_t id_;                 // Process unique, tells leases of different generators apart
+    bool leased_;
+    std::unique_ptr<SharedSegment> segment_;
+
+    // High-water mark, extend_at_ms_ is all the hot path looks at
+    std::atomic<uint64_t> extend_at_ms_;  // Timestamp that triggers next extension, never reached when disabled
+    std::atomic<uint64_t> persisted_ms_;  // Durable mark, nothing at or above it can be handed out before extension
+    uint64_t high_water_lease_ms_;
+    std::mutex high_water_mutex_;
+    std::unique_ptr<SharedSegment> high_water_;
+
+    std::atomic<int> time_source_;
+    std::mutex time_source_mutex_;
+    std::shared_ptr<Ticker> ticker_; // Keeps ticker thread running while TICKER_CLOCK is in use
+  };
+
+}  // namespace shortduid
+
+#endif
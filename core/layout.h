@@ -0,0 +1,67 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#ifndef SHORTDUID_LAYOUT_H
+#define SHORTDUID_LAYOUT_H
+
+#include <cstdint>
+
+namespace shortduid {
+
+  //
+  // Bit widths of an ID, most significant part first:
+  // | timestamp_ms | shard_id | sequence |
+  //
+  // Generator state packs the first and last part the same way, (timestamp << SEQUENCE_BITS) | sequence, so
+  // sequence overflow carries into the timestamp. Everything here is a compile time constant for the hot path.
+  //
+  template<unsigned TimestampBits, unsigned ShardBits, unsigned SequenceBits>
+  struct BitLayout {
+    static_assert(TimestampBits + ShardBits + SequenceBits == 64, "layout must fill 64 bits");
+    static_assert(TimestampBits >= 40 && SequenceBits >= 8, "layout needs decades of milliseconds and some sequence");
+
+    static const unsigned TIMESTAMP_BITS = TimestampBits;
+    static const unsigned SHARD_BITS = ShardBits;
+    static const unsigned SEQUENCE_BITS = SequenceBits;
+    static const unsigned SHARD_SHIFT = SequenceBits;
+    static const unsigned TIMESTAMP_SHIFT = ShardBits + SequenceBits;
+    static const uint64_t TIMESTAMP_MASK = (1ULL << TimestampBits) - 1;
+    static const uint64_t SHARD_MASK = (1ULL << ShardBits) - 1;
+    static const uint64_t SEQUENCE_MASK = (1ULL << SequenceBits) - 1;
+    static const uint32_t ID = (TimestampBits << 16) | (ShardBits << 8) | SequenceBits; // See Generator::Layout
+
+    //
+    // ID out of a generator state value and shard
+    //
+    static uint64_t Pack(uint64_t state, uint64_t shard_id) {
+      return (((state >> SEQUENCE_BITS) & TIMESTAMP_MASK) << TIMESTAMP_SHIFT) | ((shard_id & SHARD_MASK) << SHARD_SHIFT) | (state & SEQUENCE_MASK);
+    }
+
+    static uint64_t Timestamp(uint64_t id) { return id >> TIMESTAMP_SHIFT; }
+    static uint64_t Shard(uint64_t id) { return (id >> SHARD_SHIFT) & SHARD_MASK; }
+    static uint64_t Sequence(uint64_t id) { return id & SEQUENCE_MASK; }
+  };
+
+  template<unsigned T, unsigned S, unsigned Q> const unsigned BitLayout<T, S, Q>::TIMESTAMP_BITS;
+  template<unsigned T, unsigned S, unsigned Q> const unsigned BitLayout<T, S, Q>::SHARD_BITS;
+  template<unsigned T, unsigned S, unsigned Q> const unsigned BitLayout<T, S, Q>::SEQUENCE_BITS;
+  template<unsigned T, unsigned S, unsigned Q> const unsigned BitLayout<T, S, Q>::SHARD_SHIFT;
+  template<unsigned T, unsigned S, unsigned Q> const unsigned BitLayout<T, S, Q>::TIMESTAMP_SHIFT;
+  template<unsigned T, unsigned S, unsigned Q> const uint64_t BitLayout<T, S, Q>::TIMESTAMP_MASK;
+  template<unsigned T, unsigned S, unsigned Q> const uint64_t BitLayout<T, S, Q>::SHARD_MASK;
+  template<unsigned T, unsigned S, unsigned Q> const uint64_t BitLayout<T, S, Q>::SEQUENCE_MASK;
+  template<unsigned T, unsigned S, unsigned Q> const uint32_t BitLayout<T, S, Q>::ID;
+
+  typedef BitLayout<42, 10, 12> Layout42_10_12; // Default: 139 years, 1024 shards, 4096 IDs per millisecond
+  typedef BitLayout<41, 8, 15> Layout41_8_15;   // 69 years, 256 shards, 32768 IDs per millisecond
+  typedef BitLayout<40, 14, 10> Layout40_14_10; // 34 years, 16384 shards, 1024 IDs per millisecond
+
+  //
+  // Widths of a layout ID known only at run time, for everything off the hot path
+  //
+  inline unsigned TimestampBits(uint32_t layout) { return layout >> 16; }
+  inline unsigned ShardBits(uint32_t layout) { return (layout >> 8) & 0xff; }
+  inline unsigned SequenceBits(uint32_t layout) { return layout & 0xff; }
+
+}  // namespace shortduid
+
+#endif
+// vim: syntax=cpp11:ts=2:sw=2
@@ -0,0 +1,215 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#include "libshortduid.h"
+
+#include <climits>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include "generator.h"
+#include "shared_segment.h"
+#include "random.h"
+#include "sortable.h"
+#include "hashids.h"
+
+#define SHORTDUID_STR_(x) #x
+#define SHORTDUID_STR(x) SHORTDUID_STR_(x)
+
+static_assert(SHORTDUID_LAYOUT_42_10_12 == shortduid::Generator::LAYOUT_42_10_12 && SHORTDUID_LAYOUT_41_8_15 == shortduid::Generator::LAYOUT_41_8_15 &&
+              SHORTDUID_LAYOUT_40_14_10 == shortduid::Generator::LAYOUT_40_14_10, "C layout constants out of sync");
+static_assert(SHORTDUID_SORTABLE_WIDTH == shortduid::SortableCodec::WIDTH && SHORTDUID_SORTABLE_BASE62 == shortduid::SortableCodec::BASE62 &&
+              SHORTDUID_SORTABLE_BASE64URL == shortduid::SortableCodec::BASE64URL, "C sortable constants out of sync");
+
+struct shortduid_s {
+  shortduid_s(std::shared_ptr<shortduid::Generator> generator, const std::string &salt, unsigned int min_length = 0, const std::string &alphabet = DEFAULT_ALPHABET)
+    : generator(std::move(generator)), hash(salt, min_length, alphabet) {
+  }
+
+  std::shared_ptr<shortduid::Generator> generator;
+  hashidsxx::Hashids hash;
+  shortduid::SortableCodec sortable;
+};
+
+extern "C" {
+
+  const char *shortduid_version(void) {
+    return SHORTDUID_STR(SHORTDUID_VERSION_MAJOR) "." SHORTDUID_STR(SHORTDUID_VERSION_MINOR) "." SHORTDUID_STR(SHORTDUID_VERSION_PATCH);
+  }
+
+  shortduid_t *shortduid_new(uint32_t shard_id, const char *salt, uint64_t epoch_start) {
+    try {
+      return new shortduid_s(std::make_shared<shortduid::Generator>(shard_id, epoch_start), salt ? salt : "");
+    } catch(...) {
+      return nullptr;
+    }
+  }
+
+  shortduid_t *shortduid_new_layout(uint32_t shard_id, const char *salt, uint64_t epoch_start, uint32_t layout) {
+    try {
+      return new shortduid_s(std::make_shared<shortduid::Generator>(shard_id, epoch_start, static_cast<shortduid::Generator::Layout>(layout)), salt ? salt : "");
+    } catch(...) {
+      return nullptr;
+    }
+  }
+
+  shortduid_t *shortduid_new_hashid(uint32_t shard_id, const char *salt, uint64_t epoch_start, unsigned int min_length, const char *alphabet) {
+    std::string hash_alphabet(alphabet ? alphabet : DEFAULT_ALPHABET);
+    if(!hashidsxx::Hashids::valid_alphabet(hash_alphabet)) return nullptr;
+    try {
+      return new shortduid_s(std::make_shared<shortduid::Generator>(shard_id, epoch_start), salt ? salt : "", min_length, hash_alphabet);
+    } catch(...) {
+      return nullptr;
+    }
+  }
+
+  uint32_t shortduid_layout(const shortduid_t *duid) {
+    return duid->generator->GetLayout();
+  }
+
+  shortduid_t *shortduid_new_shared(uint32_t shard_id, const char *salt, uint64_t epoch_start) {
+    try {
+      return new shortduid_s(shortduid::Generator::Shared(shard_id, epoch_start), salt ? salt : "");
+    } catch(...) {
+      return nullptr;
+    }
+  }
+
+  shortduid_t *shortduid_new_shm(uint32_t shard_id, const char *salt, uint64_t epoch_start, const char *name) {
+    if(!name || !*name) return nullptr;
+    try {
+      return new shortduid_s(shortduid::Generator::Shared(shard_id, epoch_start, name), salt ? salt : "");
+    } catch(...) {
+      return nullptr;
+    }
+  }
+
+  int shortduid_shm_unlink(const char *name) {
+    return (name && shortduid::SharedSegment::Unlink(name)) ? 1 : 0;
+  }
+
+  void shortduid_free(shortduid_t *duid) {
+    delete duid;
+  }
+
+  int shortduid_enable_high_water_mark(shortduid_t *duid, const char *path, uint64_t lease_ms) {
+    if(!path || !*path) return 0;
+    try {
+      duid->generator->EnableHighWaterMark(path, lease_ms ? lease_ms : 10000);
+      return 1;
+    } catch(...) {
+      return 0;
+    }
+  }
+
+  int shortduid_set_time_source(shortduid_t *duid, int source) {
+    switch(source) {
+      case SHORTDUID_TIME_STEADY: duid->generator->SetTimeSource(shortduid::Generator::STEADY_CLOCK); return 1;
+      case SHORTDUID_TIME_COARSE: duid->generator->SetTimeSource(shortduid::Generator::COARSE_CLOCK); return 1;
+      case SHORTDUID_TIME_TICKER:
+        try {
+          duid->generator->SetTimeSource(shortduid::Generator::TICKER_CLOCK);
+          return 1;
+        } catch(...) {
+          return 0; // Thread could not be started
+        }
+      default: return 0;
+    }
+  }
+
+  uint32_t shortduid_shard_id(const shortduid_t *duid) {
+    return duid->generator->GetShardID();
+  }
+
+  uint64_t shortduid_epoch_start(const shortduid_t *duid) {
+    return duid->generator->GetEpochStart();
+  }
+
+  uint64_t shortduid_current_time_ms(const shortduid_t *duid) {
+    return duid->generator->GetCurrentTimeMs();
+  }
+
+  uint64_t shortduid_next(shortduid_t *duid) {
+    return duid->generator->GetUniqueID();
+  }
+
+  void shortduid_next_many(shortduid_t *duid, uint64_t *ids, size_t count) {
+    duid->generator->GetUniqueIDs(ids, count);
+  }
+
+  void shortduid_parse(const shortduid_t *duid, uint64_t id, uint64_t *timestamp_ms, uint32_t *shard_id, uint32_t *sequence) {
+    auto parts = duid->generator->Parse(id);
+    if(timestamp_ms) *timestamp_ms = parts.timestamp_ms;
+    if(shard_id) *shard_id = parts.shard_id;
+    if(sequence) *sequence = parts.sequence;
+  }
+
+  uint64_t shortduid_min_id_for_time(const shortduid_t *duid, uint64_t unix_ms) {
+    return duid->generator->MinIdForTime(unix_ms);
+  }
+
+  uint64_t shortduid_max_id_for_time(const shortduid_t *duid, uint64_t unix_ms) {
+    return duid->generator->MaxIdForTime(unix_ms);
+  }
+
+  void shortduid_get_stats(shortduid_t *duid, shortduid_stats_t *stats, int reset) {
+    auto snapshot = duid->generator->GetStats(reset != 0);
+    stats->ids_issued = snapshot.ids_issued;
+    stats->sequence_overflows = snapshot.sequence_overflows;
+    stats->clock_regressions = snapshot.clock_regressions;
+    stats->max_drift_ms = snapshot.max_drift_ms;
+    stats->current_drift_ms = snapshot.current_drift_ms;
+  }
+
+  size_t shortduid_hashid_encode(const shortduid_t *duid, uint64_t number, char *output, size_t capacity) {
+    if(capacity < duid->hash.max_length()) return 0;
+    try {
+      return duid->hash.encode_one(number, output);
+    } catch(...) {
+      return 0;
+    }
+  }
+
+  size_t shortduid_hashid_max_length(const shortduid_t *duid) {
+    return duid->hash.max_length();
+  }
+
+  int shortduid_hashid_decode(const shortduid_t *duid, const char *hashid, size_t length, uint64_t *number) {
+    try {
+      return duid->hash.decode_one(hashid, length, *number) ? 1 : 0;
+    } catch(...) {
+      return 0;
+    }
+  }
+
+  int shortduid_set_sortable(shortduid_t *duid, int alphabet, const char *key) {
+    if(alphabet != SHORTDUID_SORTABLE_BASE62 && alphabet != SHORTDUID_SORTABLE_BASE64URL) return 0;
+    uint32_t layout = duid->generator->GetLayout();
+    try {
+      duid->sortable = shortduid::SortableCodec(static_cast<shortduid::SortableCodec::Alphabet>(alphabet), key ? key : "",
+                                                shortduid::ShardBits(layout) + shortduid::SequenceBits(layout));
+      return 1;
+    } catch(...) {
+      return 0;
+    }
+  }
+
+  void shortduid_sortable_encode(const shortduid_t *duid, uint64_t id, char *output) {
+    duid->sortable.Encode(id, output);
+  }
+
+  int shortduid_sortable_decode(const shortduid_t *duid, const char *key, size_t length, uint64_t *id) {
+    return duid->sortable.Decode(key, length, *id) ? 1 : 0;
+  }
+
+  size_t shortduid_random_string(char *output, size_t length, const char *alphabet) {
+    if(alphabet == nullptr || *alphabet == '\0' || length > USHRT_MAX) return 0;
+    try {
+      auto random(shortduid::GetRandomString(length, alphabet));
+      random.copy(output, length);
+      return length;
+    } catch(...) {
+      return 0;
+    }
+  }
+
+}
@@ -0,0 +1,176 @@
+/*
+ * libshortduid - C interface to ShortDUID generator, hashid codec and random
+ * string generator. IDs and hashids are identical to the ones produced by the
+ * node.js module given the same shard_id, salt and epoch_start.
+ *
+ * Functions never throw or abort, failures are reported through return values.
+ * ID generation is thread safe, one instance can be shared by many threads.
+ */
+#ifndef LIBSHORTDUID_H
+#define LIBSHORTDUID_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHORTDUID_VERSION_MAJOR 1
+#define SHORTDUID_VERSION_MINOR 4
+#define SHORTDUID_VERSION_PATCH 5
+
+#if defined(_WIN32) && defined(SHORTDUID_SHARED)
+#  ifdef SHORTDUID_BUILDING
+#    define SHORTDUID_API __declspec(dllexport)
+#  else
+#    define SHORTDUID_API __declspec(dllimport)
+#  endif
+#else
+#  define SHORTDUID_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct shortduid_s shortduid_t;
+
+/* Library version as "major.minor.patch" */
+SHORTDUID_API const char *shortduid_version(void);
+
+/*
+ * Create new instance, shard_id is masked to 10 bits, epoch_start is in
+ * milliseconds since unix epoch and reset to 0 if it is in the future.
+ * salt may be NULL. Returns NULL on allocation failure.
+ */
+SHORTDUID_API shortduid_t *shortduid_new(uint32_t shard_id, const char *salt, uint64_t epoch_start);
+SHORTDUID_API void shortduid_free(shortduid_t *duid);
+
+/*
+ * Bit layout of IDs, timestamp/shard/sequence widths, see core/layout.h.
+ * Values are (timestamp_bits << 16) | (shard_bits << 8) | sequence_bits.
+ */
+#define SHORTDUID_LAYOUT_42_10_12 0x2a0a0c
+#define SHORTDUID_LAYOUT_41_8_15 0x29080f
+#define SHORTDUID_LAYOUT_40_14_10 0x280e0a
+
+/*
+ * Same as shortduid_new with one of the SHORTDUID_LAYOUT_* layouts, shard_id
+ * is masked to its shard bits. Returns NULL for unknown layout.
+ */
+SHORTDUID_API shortduid_t *shortduid_new_layout(uint32_t shard_id, const char *salt, uint64_t epoch_start, uint32_t layout);
+SHORTDUID_API uint32_t shortduid_layout(const shortduid_t *duid);
+
+/*
+ * Same as shortduid_new with hashids of at least min_length characters from
+ * alphabet, NULL for the default one. Returns NULL unless alphabet is at
+ * least 16 unique printable ASCII characters without spaces.
+ */
+SHORTDUID_API shortduid_t *shortduid_new_hashid(uint32_t shard_id, const char *salt, uint64_t epoch_start, unsigned int min_length, const char *alphabet);
+
+/*
+ * Same as shortduid_new, but all instances of the same shard_id and
+ * epoch_start in the process share one generator, which stays unique when
+ * used from many threads at once. Each thread leases blocks of sequence
+ * numbers, so IDs are monotonic per thread only.
+ */
+SHORTDUID_API shortduid_t *shortduid_new_shared(uint32_t shard_id, const char *salt, uint64_t epoch_start);
+
+/*
+ * Same as shortduid_new_shared, with generator state kept in the POSIX
+ * shared memory segment name, so every process of the host opening it
+ * shares one shard. Returns NULL if the segment can not be mapped or was
+ * set up for a different shard_id or epoch_start. Segments persist until
+ * removed with shortduid_shm_unlink() or reboot.
+ */
+SHORTDUID_API shortduid_t *shortduid_new_shm(uint32_t shard_id, const char *salt, uint64_t epoch_start, const char *name);
+/* Returns 1 if segment name was removed, processes using it are not affected */
+SHORTDUID_API int shortduid_shm_unlink(const char *name);
+
+/*
+ * Keep high-water mark of handed out timestamps in file path, so IDs after a
+ * restart resume strictly above anything handed out before, even if the clock
+ * was stepped back. Mark is reserved lease_ms ahead (0 for default of 10
+ * seconds) and synced to disk only when extended. Call before generating IDs.
+ * Returns 1 on success, 0 if the file can not be used or belongs to another
+ * shard_id or epoch_start.
+ */
+SHORTDUID_API int shortduid_enable_high_water_mark(shortduid_t *duid, const char *path, uint64_t lease_ms);
+
+/*
+ * Time source of the generator, see shortduid::Generator::TimeSource.
+ * Returns 1 on success, 0 for unknown source.
+ */
+#define SHORTDUID_TIME_STEADY 0
+#define SHORTDUID_TIME_COARSE 1
+#define SHORTDUID_TIME_TICKER 2
+SHORTDUID_API int shortduid_set_time_source(shortduid_t *duid, int source);
+
+SHORTDUID_API uint32_t shortduid_shard_id(const shortduid_t *duid);
+SHORTDUID_API uint64_t shortduid_epoch_start(const shortduid_t *duid);
+/* Milliseconds since unix epoch as seen by the generator */
+SHORTDUID_API uint64_t shortduid_current_time_ms(const shortduid_t *duid);
+
+/* Unique, monotonically increasing IDs (per thread for shared instances) */
+SHORTDUID_API uint64_t shortduid_next(shortduid_t *duid);
+SHORTDUID_API void shortduid_next_many(shortduid_t *duid, uint64_t *ids, size_t count);
+
+/*
+ * Parts of id according to layout and epoch_start of duid, timestamp in
+ * milliseconds since unix epoch. Any output may be NULL.
+ */
+SHORTDUID_API void shortduid_parse(const shortduid_t *duid, uint64_t id, uint64_t *timestamp_ms, uint32_t *shard_id, uint32_t *sequence);
+
+/*
+ * Smallest and largest ID any shard can hand out in the millisecond
+ * unix_ms, for time filters turned into ID range scans
+ */
+SHORTDUID_API uint64_t shortduid_min_id_for_time(const shortduid_t *duid, uint64_t unix_ms);
+SHORTDUID_API uint64_t shortduid_max_id_for_time(const shortduid_t *duid, uint64_t unix_ms);
+
+/* Generator counters, see shortduid::Generator::Stats */
+typedef struct shortduid_stats_s {
+  uint64_t ids_issued;
+  uint64_t sequence_overflows;
+  uint64_t clock_regressions;
+  uint64_t max_drift_ms;
+  uint64_t current_drift_ms;
+} shortduid_stats_t;
+
+/* Snapshot of counters, cleared afterwards if reset is non-zero */
+SHORTDUID_API void shortduid_get_stats(shortduid_t *duid, shortduid_stats_t *stats, int reset);
+
+/*
+ * Hashid of single number, without terminating NUL. Returns number of
+ * characters written or 0 if capacity is less than
+ * shortduid_hashid_max_length().
+ */
+SHORTDUID_API size_t shortduid_hashid_encode(const shortduid_t *duid, uint64_t number, char *output, size_t capacity);
+SHORTDUID_API size_t shortduid_hashid_max_length(const shortduid_t *duid);
+/* Returns 1 and stores the number if hashid is valid encoding of single number, 0 otherwise */
+SHORTDUID_API int shortduid_hashid_decode(const shortduid_t *duid, const char *hashid, size_t length, uint64_t *number);
+
+/*
+ * Fixed width keys of IDs whose byte-wise order is the order of the IDs, see
+ * shortduid::SortableCodec. Base62 without key unless set otherwise; a key
+ * (NULL or empty for none) permutes the shard and sequence bits of every ID.
+ * Not safe while other threads encode or decode. Returns 1 on success, 0 for
+ * unknown alphabet.
+ */
+#define SHORTDUID_SORTABLE_WIDTH 11
+#define SHORTDUID_SORTABLE_BASE62 0
+#define SHORTDUID_SORTABLE_BASE64URL 1
+SHORTDUID_API int shortduid_set_sortable(shortduid_t *duid, int alphabet, const char *key);
+/* Writes SHORTDUID_SORTABLE_WIDTH characters, without terminating NUL */
+SHORTDUID_API void shortduid_sortable_encode(const shortduid_t *duid, uint64_t id, char *output);
+/* Returns 1 and stores the ID if key is valid, 0 otherwise */
+SHORTDUID_API int shortduid_sortable_decode(const shortduid_t *duid, const char *key, size_t length, uint64_t *id);
+
+/*
+ * Fill output with length random characters drawn from NUL terminated
+ * alphabet, without terminating NUL. Returns length or 0 on failure.
+ */
+SHORTDUID_API size_t shortduid_random_string(char *output, size_t length, const char *alphabet);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
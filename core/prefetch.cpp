@@ -0,0 +1,120 @@
+#include "prefetch.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace shortduid {
+
+  const size_t Prefetcher::BATCH;
+
+  namespace {
+
+    size_t RoundUpToPowerOfTwo(size_t n) {
+      size_t ret = 1;
+      while(ret < n) ret <<= 1;
+      return ret;
+    }
+
+  }  // namespace
+
+  Prefetcher::Prefetcher(std::shared_ptr<Generator> generator, const hashidsxx::Hashids& hash, size_t depth, size_t low_watermark, uint64_t max_age_ms)
+    : generator_(std::move(generator)), hash_(hash), capacity_(RoundUpToPowerOfTwo(std::max(depth, BATCH))), max_age_ms_(max_age_ms), stride_(hash.max_length()), floor_(std::make_shared<std::atomic<uint64_t>>(0)) {
+    timestamp_shift_ = ShardBits(generator_->GetLayout()) + SequenceBits(generator_->GetLayout());
+    low_watermark_ = std::min(low_watermark, capacity_ - 1); // Ring full must be above it, or the thread never sleeps
+    ids_.resize(capacity_);
+    lengths_.resize(capacity_);
+    hashes_.resize(capacity_ * stride_);
+    head_ = 0;
+    tail_ = 0;
+    sleeping_ = false;
+    stop_ = false;
+    thread_ = std::thread(&Prefetcher::Run, this);
+  }
+
+  Prefetcher::~Prefetcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+  }
+
+  void Prefetcher::Advance(std::atomic<uint64_t>& floor, uint64_t id) {
+    uint64_t current = floor.load(std::memory_order_relaxed);
+    while(current < id && !floor.compare_exchange_weak(current, id, std::memory_order_relaxed));
+  }
+
+  void Prefetcher::Take(size_t cnt, char* hashes, uint32_t* lengths, uint64_t* ids) {
+    size_t mask = capacity_ - 1;
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+
+    // Ring is ascending, whatever is below the floor sits in front. Newest entry first, so a ring gone stale all at
+    // once (idle for max_age_ms, or passed by directly generated IDs) is dropped in one go
+    uint64_t now_ms = generator_->GetMillisecondsSinceThisEpoch();
+    uint64_t min_ms = (now_ms > max_age_ms_) ? now_ms - max_age_ms_ : 0;
+    uint64_t floor = floor_->load(std::memory_order_relaxed);
+    auto usable = [&](uint64_t id) { return id > floor && (id >> timestamp_shift_) >= min_ms; };
+    if(tail != head && !usable(ids_[(head - 1) & mask])) tail = head;
+    while(tail != head && !usable(ids_[tail & mask])) ++tail;
+
+    size_t i = 0;
+    for(; i < cnt && tail != head; ++i, ++tail) {
+      size_t slot = tail & mask;
+      if(ids) ids[i] = ids_[slot];
+      lengths[i] = lengths_[slot];
+      std::memcpy(hashes + i * stride_, &hashes_[slot * stride_], lengths_[slot]);
+    }
+    if(i > 0) {
+      Advance(ids_[(tail - 1) & mask]);
+      generator_->CountIssued(i);
+    }
+
+    // Release the slots, then tell the thread if it waits for exactly that. Store and load pair up with the thread's
+    // own sleeping_ store and tail_ load, one of the two sides always sees the other
+    tail_.store(tail, std::memory_order_seq_cst);
+    if(head - tail <= low_watermark_ && sleeping_.load(std::memory_order_seq_cst)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      wakeup_.notify_one();
+    }
+
+    // Ring ran dry, the rest is generated right here and lands above everything in the ring
+    uint64_t direct[BATCH];
+    while(i < cnt) {
+      size_t chunk = std::min(cnt - i, BATCH);
+      generator_->GetUniqueIDs(direct, chunk);
+      for(size_t j = 0; j < chunk; ++j, ++i) {
+        if(ids) ids[i] = direct[j];
+        lengths[i] = (uint32_t) hash_.encode_one(direct[j], hashes + i * stride_);
+      }
+      Advance(direct[chunk - 1]);
+    }
+  }
+
+  void Prefetcher::Run() {
+    size_t mask = capacity_ - 1;
+    size_t head = head_.load(std::memory_order_relaxed);
+    while(!stop_.load(std::memory_order_relaxed)) {
+      size_t free = capacity_ - (head - tail_.load(std::memory_order_acquire));
+      if(free == 0) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleeping_.store(true, std::memory_order_seq_cst);
+        wakeup_.wait(lock, [&]() { return stop_.load(std::memory_order_relaxed) || head - tail_.load(std::memory_order_seq_cst) <= low_watermark_; });
+        sleeping_.store(false, std::memory_order_relaxed);
+        continue;
+      }
+
+      // Fill up to the wrap around in batches, consumer sees each batch as soon as it is encoded
+      size_t slot = head & mask;
+      size_t n = std::min(std::min(free, BATCH), capacity_ - slot);
+      generator_->ReserveUniqueIDs(&ids_[slot], n);
+      for(size_t i = slot; i < slot + n; ++i) {
+        lengths_[i] = (uint32_t) hash_.encode_one(ids_[i], &hashes_[i * stride_]);
+      }
+      head += n;
+      head_.store(head, std::memory_order_release);
+    }
+  }
+
+}  // namespace shortduid
@@ -0,0 +1,91 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#ifndef SHORTDUID_PREFETCH_H
+#define SHORTDUID_PREFETCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "generator.h"
+#include "hashids.h"
+
+namespace shortduid {
+
+  //
+  // Ring of IDs generated and hashid encoded ahead of time by a background thread, so a burst is served by copying
+  // instead of generating (and borrowing from future milliseconds) on the caller's thread. Single producer (the
+  // thread) and single consumer (Take(), one thread at a time) lock-free ring; the thread is only woken up once the
+  // ring drains to low_watermark.
+  //
+  // IDs handed out stay monotonic: whatever the ring can not cover Take() generates directly, and anything in the ring
+  // not above the floor or older than max_age_ms is skipped. The floor is the newest ID handed out by Take() or by
+  // anyone else generating IDs of the same instance who raises it with Advance(), so IDs stay monotonic across both.
+  // Ring entries count as issued in the generator's stats when Take() hands them out, skipped ones never do.
+  //
+  // The thread does not survive fork, a child must not use or destroy a Prefetcher created before it.
+  //
+  class Prefetcher {
+  public:
+    //
+    // hash must outlive the Prefetcher, depth is rounded up to a power of two of at least BATCH
+    //
+    Prefetcher(std::shared_ptr<Generator> generator, const hashidsxx::Hashids& hash, size_t depth = 4096, size_t low_watermark = 1024, uint64_t max_age_ms = 1000);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    //
+    // cnt IDs, hashid of i-th written to hashes + i * hash.max_length() and its length to lengths[i], IDs to ids if given
+    //
+    void Take(size_t cnt, char* hashes, uint32_t* lengths, uint64_t* ids = nullptr);
+
+    size_t GetDepth() const { return capacity_; }
+
+    //
+    // Floor of the ring, to be raised to the last of every batch of IDs generated outside it. Shared, so that batches
+    // completing off the event loop can still raise it after the Prefetcher is gone.
+    //
+    std::shared_ptr<std::atomic<uint64_t>> GetFloor() const { return floor_; }
+    static void Advance(std::atomic<uint64_t>& floor, uint64_t id);
+    void Advance(uint64_t id) { Advance(*floor_, id); }
+
+  private:
+    static const size_t BATCH = 256; // IDs generated and published at once
+
+    void Run();
+
+    std::shared_ptr<Generator> generator_;
+    const hashidsxx::Hashids& hash_;
+    size_t capacity_;             // Power of two
+    size_t low_watermark_;
+    uint64_t max_age_ms_;
+    size_t stride_;               // Bytes per encoded ID
+    unsigned timestamp_shift_;    // Of the generator's layout
+    std::vector<uint64_t> ids_;
+    std::vector<uint32_t> lengths_;
+    std::vector<char> hashes_;
+    std::shared_ptr<std::atomic<uint64_t>> floor_; // Newest ID handed out, see GetFloor()
+
+    // Producer and consumer positions on their own cache lines, free running
+    char padding_head_[64];
+    std::atomic<size_t> head_;
+    char padding_tail_[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail_;
+    char padding_end_[64 - sizeof(std::atomic<size_t>)];
+
+    std::atomic<bool> sleeping_;  // Producer waits for the ring to drain to low_watermark_
+    std::atomic<bool> stop_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::thread thread_;
+  };
+
+}  // namespace shortduid
+
+#endif
+// vim: syntax=cpp11:ts=2:sw=2
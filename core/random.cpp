@@ -0,0 +1,194 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#include "random.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace shortduid {
+
+  namespace {
+
+    //
+    // Bumped in every forked child, pools compare it with the generation they were seeded in
+    //
+    std::atomic<uint64_t> fork_generation(0);
+
+#ifndef _WIN32
+    void OnFork() {
+      fork_generation.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::once_flag fork_handler_once;
+#endif
+
+    //
+    // Seed material from the OS
+    //
+    void GetEntropy(void* output, size_t len) {
+      uint8_t* p = static_cast<uint8_t*>(output);
+
+#if defined(__linux__) && defined(SYS_getrandom)
+      while(len > 0) {
+        long ret = syscall(SYS_getrandom, p, len, 0);
+        if(ret < 0) {
+          if(errno == EINTR) continue;
+          break; // Old kernel, try /dev/urandom
+        }
+        p += ret;
+        len -= ret;
+      }
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__)
+      arc4random_buf(p, len);
+      len = 0;
+#endif
+
+#ifndef _WIN32
+      if(len > 0) {
+        if(FILE* urandom = std::fopen("/dev/urandom", "rb")) {
+          size_t got = std::fread(p, 1, len, urandom);
+          std::fclose(urandom);
+          p += got;
+          len -= got;
+        }
+      }
+#endif
+
+      if(len > 0) {
+        std::random_device rd;
+        for(; len > 0; --len) *p++ = static_cast<uint8_t>(rd());
+      }
+    }
+
+    //
+    // ChaCha20 block function, RFC 8439
+    //
+    inline uint32_t Rotl(uint32_t v, int c) {
+      return (v << c) | (v >> (32 - c));
+    }
+
+    inline void QuarterRound(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d) {
+      a += b; d ^= a; d = Rotl(d, 16);
+      c += d; b ^= c; b = Rotl(b, 12);
+      a += b; d ^= a; d = Rotl(d, 8);
+      c += d; b ^= c; b = Rotl(b, 7);
+    }
+
+    void ChaCha20Block(const uint32_t key[8], uint32_t counter, const uint32_t nonce[3], uint8_t output[64]) {
+      uint32_t state[16] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+        key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+        counter, nonce[0], nonce[1], nonce[2]
+      };
+      uint32_t x[16];
+      std::memcpy(x, state, sizeof(x));
+
+      for(int i = 0; i < 10; ++i) {
+        QuarterRound(x[0], x[4], x[8], x[12]);
+        QuarterRound(x[1], x[5], x[9], x[13]);
+        QuarterRound(x[2], x[6], x[10], x[14]);
+        QuarterRound(x[3], x[7], x[11], x[15]);
+        QuarterRound(x[0], x[5], x[10], x[15]);
+        QuarterRound(x[1], x[6], x[11], x[12]);
+        QuarterRound(x[2], x[7], x[8], x[13]);
+        QuarterRound(x[3], x[4], x[9], x[14]);
+      }
+
+      for(int i = 0; i < 16; ++i) {
+        uint32_t v = x[i] + state[i];
+        output[4 * i + 0] = static_cast<uint8_t>(v);
+        output[4 * i + 1] = static_cast<uint8_t>(v >> 8);
+        output[4 * i + 2] = static_cast<uint8_t>(v >> 16);
+        output[4 * i + 3] = static_cast<uint8_t>(v >> 24);
+      }
+    }
+
+  }  // namespace
+
+  RandomPool::RandomPool() {
+#ifndef _WIN32
+    std::call_once(fork_handler_once, []() { pthread_atfork(nullptr, nullptr, OnFork); });
+#endif
+    Seed();
+  }
+
+  RandomPool::~RandomPool() {
+    // Do not leave key material behind
+    volatile uint8_t* p = reinterpret_cast<volatile uint8_t*>(key_);
+    for(size_t i = 0; i < sizeof(key_); ++i) p[i] = 0;
+    p = buffer_;
+    for(size_t i = 0; i < sizeof(buffer_); ++i) p[i] = 0;
+  }
+
+  void RandomPool::Seed() {
+    GetEntropy(key_, sizeof(key_));
+    GetEntropy(nonce_, sizeof(nonce_));
+    fork_generation_ = fork_generation.load(std::memory_order_relaxed);
+    Refill();
+  }
+
+  void RandomPool::Refill() {
+    // Every key only ever produces one buffer, block counter starts over with it
+    for(uint32_t block = 0; block < BUFFER_SIZE / 64; ++block) {
+      ChaCha20Block(key_, block, nonce_, buffer_ + block * 64);
+    }
+
+    // Fast key erasure: next key comes from this output and is never handed out
+    for(size_t i = 0; i < 8; ++i) {
+      key_[i] = buffer_[4 * i] | (buffer_[4 * i + 1] << 8) | (buffer_[4 * i + 2] << 16) | (static_cast<uint32_t>(buffer_[4 * i + 3]) << 24);
+    }
+    std::memset(buffer_, 0, sizeof(key_));
+    position_ = sizeof(key_);
+  }
+
+  void RandomPool::Fill(char* output, size_t len, const std::string &alphabet) {
+    const uint32_t size = alphabet.size();
+    if(size == 0 || size > 256) throw std::invalid_argument("alphabet has to have 1 to 256 characters");
+
+    // Multiply-shift maps a byte onto the alphabet, bytes landing in the low remainder are rejected so every character
+    // is equally likely, no division per character
+    const uint32_t threshold = 256 % size;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(fork_generation_ != fork_generation.load(std::memory_order_relaxed)) {
+      Seed(); // We are in a forked child, do not repeat what the parent hands out
+    }
+
+    size_t i = 0;
+    while(i < len) {
+      if(position_ == BUFFER_SIZE) Refill();
+
+      size_t start = position_;
+      while(i < len && position_ < BUFFER_SIZE) {
+        uint32_t m = buffer_[position_++] * size;
+        if((m & 0xFF) < threshold) continue;
+        output[i++] = alphabet[m >> 8];
+      }
+      std::memset(buffer_ + start, 0, position_ - start); // Handed out bytes are gone for good
+    }
+  }
+
+  std::string RandomPool::GetRandomString(size_t len, const std::string &alphabet) {
+    std::string output(len, '\0');
+    if(len > 0) Fill(&output[0], len, alphabet);
+    return output;
+  }
+
+  std::string GetRandomString(unsigned short len, const std::string &alphabet) {
+    static RandomPool pool;
+    return pool.GetRandomString(len, alphabet);
+  }
+
+}  // namespace shortduid
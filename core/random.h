@@ -0,0 +1,55 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#ifndef SHORTDUID_RANDOM_H
+#define SHORTDUID_RANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace shortduid {
+
+  const std::string URLSAFE_ALPHABET = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  const std::string PASSWORD_ALPHABET = "!#$%&()=-~^[{]};+:*_?/><0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+  //
+  // Buffered CSPRNG: ChaCha20 keystream keyed from the OS (getrandom, /dev/urandom), rekeyed from its own output on
+  // every refill so earlier output can not be reconstructed. Reseeds itself in a forked child, so parent and child
+  // never share output. Thread safe.
+  //
+  class RandomPool {
+  public:
+    RandomPool();
+    ~RandomPool();
+
+    RandomPool(const RandomPool&) = delete;
+    RandomPool& operator=(const RandomPool&) = delete;
+
+    //
+    // Fill output with len characters drawn uniformly from alphabet (1 to 256 characters)
+    //
+    void Fill(char* output, size_t len, const std::string &alphabet);
+    std::string GetRandomString(size_t len, const std::string &alphabet);
+
+  private:
+    static const size_t BUFFER_SIZE = 512; // 8 ChaCha20 blocks, first 32 bytes of each refill become the next key
+
+    void Seed();
+    void Refill();
+
+    std::mutex mutex_;
+    uint32_t key_[8];
+    uint32_t nonce_[3];
+    uint64_t fork_generation_;
+    uint8_t buffer_[BUFFER_SIZE];
+    size_t position_;
+  };
+
+  //
+  // Password and key generator, process wide pool
+  //
+  std::string GetRandomString(unsigned short len, const std::string &alphabet);
+
+}  // namespace shortduid
+
+#endif
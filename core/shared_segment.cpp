@@ -0,0 +1,135 @@
+#include "shared_segment.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace shortduid {
+
+  const uint32_t SharedSegment::MAGIC;
+  const uint32_t SharedSegment::MAGIC_HIGH_WATER;
+  const uint32_t SharedSegment::VERSION;
+  const uint64_t SharedSegment::INIT_READY;
+  const uint64_t SharedSegment::INIT_BUSY;
+  const int SharedSegment::INIT_TIMEOUT_MS;
+
+  namespace {
+
+    std::runtime_error SystemError(const std::string& what, const std::string& name) {
+      return std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+    }
+
+    std::string LayoutString(uint32_t layout) {
+      return std::to_string(layout >> 16) + "/" + std::to_string((layout >> 8) & 0xff) + "/" + std::to_string(layout & 0xff);
+    }
+
+  }  // namespace
+
+  std::string SharedSegment::NormalizeName(const std::string& name) {
+    // POSIX wants exactly one leading slash and no others
+    return (name.empty() || name[0] != '/') ? "/" + name : name;
+  }
+
+#ifndef _WIN32
+  SharedSegment::SharedSegment(const std::string& name, uint32_t layout, uint32_t shard_id, uint64_t epoch_start, Backing backing) : name_(backing == SHM_SEGMENT ? NormalizeName(name) : name), header_(nullptr) {
+    static_assert(sizeof(Header) == 128, "state must sit on its own cache line");
+    if(!std::atomic<uint64_t>().is_lock_free()) {
+      throw std::runtime_error("shared memory generator needs lock-free 64 bit atomics");
+    }
+
+    int fd = (backing == SHM_SEGMENT) ? shm_open(name_.c_str(), O_RDWR | O_CREAT, 0600) : open(name_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if(fd < 0) throw SystemError(backing == SHM_SEGMENT ? "shm_open" : "open", name_);
+
+    // Everyone opening it sizes it, new space reads as zeros: uninitialized header, state before any ID
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (st.st_size < (off_t) sizeof(Header) && ftruncate(fd, sizeof(Header)) != 0 && (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(Header)))) {
+      auto error = SystemError("ftruncate", name_);
+      close(fd);
+      throw error;
+    }
+
+    void* mapping = mmap(nullptr, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) throw SystemError("mmap", name_);
+    header_ = static_cast<Header*>(mapping);
+
+    try {
+      Initialize(backing == SHM_SEGMENT ? MAGIC : MAGIC_HIGH_WATER, layout, shard_id, epoch_start);
+    } catch(...) {
+      munmap(header_, sizeof(Header));
+      throw;
+    }
+  }
+
+  SharedSegment::~SharedSegment() {
+    munmap(header_, sizeof(Header));
+  }
+
+  void SharedSegment::Initialize(uint32_t magic, uint32_t layout, uint32_t shard_id, uint64_t epoch_start) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(INIT_TIMEOUT_MS);
+    uint64_t init = header_->init.load(std::memory_order_acquire);
+    while(init != INIT_READY) {
+      // Fresh segment, or whoever started setting it up is gone
+      bool abandoned = (init & INIT_BUSY) && (std::chrono::steady_clock::now() > deadline || (kill((pid_t) (init & ~INIT_BUSY), 0) != 0 && errno == ESRCH));
+      if((init == 0 || abandoned) && header_->init.compare_exchange_strong(init, INIT_BUSY | (uint64_t) getpid(), std::memory_order_acquire)) {
+        // State is left alone, whatever a dead process got to hand out stays handed out
+        header_->magic = magic;
+        header_->version = VERSION;
+        header_->layout = layout;
+        header_->shard_id = shard_id;
+        header_->epoch_start = epoch_start;
+        header_->init.store(INIT_READY, std::memory_order_release);
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      init = header_->init.load(std::memory_order_acquire);
+    }
+
+    std::string what(magic == MAGIC ? "shared memory segment " : "high-water mark file ");
+    if(header_->magic != magic || header_->version != VERSION) {
+      throw std::runtime_error(what + name_ + " is not a ShortDUID " + (magic == MAGIC ? "generator" : "high-water mark") + " of version " + std::to_string(VERSION));
+    }
+    if(header_->layout != layout || header_->shard_id != shard_id || header_->epoch_start != epoch_start) {
+      throw std::runtime_error(what + name_ + " belongs to layout " + LayoutString(header_->layout) +
+                               ", shard " + std::to_string(header_->shard_id) + ", epoch start " + std::to_string(header_->epoch_start));
+    }
+  }
+
+  bool SharedSegment::Sync() {
+    return msync(header_, sizeof(Header), MS_SYNC) == 0;
+  }
+
+  bool SharedSegment::Unlink(const std::string& name) {
+    return shm_unlink(NormalizeName(name).c_str()) == 0;
+  }
+#else
+  SharedSegment::SharedSegment(const std::string& name, uint32_t, uint32_t, uint64_t, Backing) : name_(name), header_(nullptr) {
+    throw std::runtime_error("shared memory generator and high-water mark are not supported on this platform");
+  }
+
+  bool SharedSegment::Sync() {
+    return false;
+  }
+
+  SharedSegment::~SharedSegment() {
+  }
+
+  void SharedSegment::Initialize(uint32_t, uint32_t, uint32_t, uint64_t) {
+  }
+
+  bool SharedSegment::Unlink(const std::string&) {
+    return false;
+  }
+#endif
+
+}  // namespace shortduid
@@ -0,0 +1,78 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#ifndef SHORTDUID_SHARED_SEGMENT_H
+#define SHORTDUID_SHARED_SEGMENT_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace shortduid {
+
+  //
+  // One word of generator state mapped from a POSIX shared memory segment, so every process on the host can hand out
+  // IDs of one shard, or from a file, where it keeps the high-water mark of handed out timestamps across restarts.
+  // Either outlives the processes using it. The word only ever grows through CAS, so a process dying at any point
+  // leaves nothing to repair; the header set up once by whoever opens it first is taken over if that process dies
+  // half way.
+  //
+  // Throws std::runtime_error if it can not be mapped or was set up for another shard, epoch or layout.
+  //
+  class SharedSegment {
+  public:
+    static const uint32_t MAGIC = 0x44554944;            // "DUID", state word is (timestamp << sequence bits) | sequence
+    static const uint32_t MAGIC_HIGH_WATER = 0x44554948; // "DUIH", state word is milliseconds since custom epoch
+    static const uint32_t VERSION = 1;
+
+    enum Backing {
+      SHM_SEGMENT, // name is a shared memory segment name
+      MAPPED_FILE  // name is a file path, Sync() makes the word durable
+    };
+
+    SharedSegment(const std::string& name, uint32_t layout, uint32_t shard_id, uint64_t epoch_start, Backing backing = SHM_SEGMENT);
+    ~SharedSegment();
+
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    std::atomic<uint64_t>& State() { return header_->state; }
+    const std::string& GetName() const { return name_; }
+
+    //
+    // Write the mapping back to the file and wait for it, returns false on I/O error
+    //
+    bool Sync();
+
+    //
+    // Remove segment name, processes that have it mapped keep using it
+    //
+    static bool Unlink(const std::string& name);
+
+  private:
+    static const uint64_t INIT_READY = ~0ULL;
+    static const uint64_t INIT_BUSY = 1ULL << 63; // | pid of the process setting the header up
+    static const int INIT_TIMEOUT_MS = 1000;      // Header takes microseconds, anything longer is a dead or stuck process
+
+    struct Header {
+      std::atomic<uint64_t> init;
+      uint32_t magic;
+      uint32_t version;
+      uint32_t layout;
+      uint32_t shard_id;
+      uint64_t epoch_start;
+      char padding[64 - 4 * sizeof(uint32_t) - 2 * sizeof(uint64_t)];
+      std::atomic<uint64_t> state; // Own cache line, see MAGIC*
+      char state_padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    void Initialize(uint32_t magic, uint32_t layout, uint32_t shard_id, uint64_t epoch_start);
+
+    static std::string NormalizeName(const std::string& name);
+
+    std::string name_;
+    Header* header_;
+  };
+
+}  // namespace shortduid
+
+#endif
+// vim: syntax=cpp11:ts=2:sw=2
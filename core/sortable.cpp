@@ -0,0 +1,180 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#include "sortable.h"
+
+#include <cstring>
+
+namespace shortduid {
+
+  const size_t SortableCodec::WIDTH;
+  const unsigned SortableCodec::ROUNDS;
+
+  namespace {
+
+    const char BASE62_DIGITS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    const char BASE64URL_DIGITS[] = "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz";
+
+    // Base62 keys are one digit and two chunks of five, each chunk below 2^32
+    const uint64_t CHUNK = 62ULL * 62 * 62 * 62 * 62;
+    const uint64_t MAX_HIGH = UINT64_MAX / CHUNK;
+    const uint64_t MAX_LOW = UINT64_MAX % CHUNK;
+
+    // Invalid digits have the high bit set, valid ones are below 64
+    const uint32_t INVALID = 0x80;
+
+    uint64_t SplitMix64(uint64_t& state) {
+      uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+
+    // Five base62 digits of chunk < 62^5, the first one alone and the others in pairs
+    void PutChunk(uint32_t chunk, const char* digits, char* output) {
+      uint32_t upper = chunk / (62 * 62);
+      uint32_t pair = chunk - upper * (62 * 62);
+      output[3] = digits[pair / 62];
+      output[4] = digits[pair % 62];
+      uint32_t first = upper / (62 * 62);
+      pair = upper - first * (62 * 62);
+      output[1] = digits[pair / 62];
+      output[2] = digits[pair % 62];
+      output[0] = digits[first];
+    }
+
+    uint32_t GetChunk(const uint8_t* values, const char* input, uint32_t& invalid) {
+      uint32_t digits[5];
+      for(int i = 0; i < 5; ++i) {
+        digits[i] = values[static_cast<uint8_t>(input[i])];
+        invalid |= digits[i];
+      }
+      // Garbage for invalid digits, but never out of range: values are below 256
+      return (((digits[0] * 62 + digits[1]) * 62 + digits[2]) * 62 + digits[3]) * 62 + digits[4];
+    }
+
+  }  // namespace
+
+  SortableCodec::SortableCodec(Alphabet alphabet, const std::string& key, unsigned permuted_bits)
+    : alphabet_(alphabet), digits_(alphabet == BASE64URL ? BASE64URL_DIGITS : BASE62_DIGITS) {
+    values_.fill(INVALID | 0x7f);
+    for(unsigned i = 0; digits_[i]; ++i) values_[static_cast<uint8_t>(digits_[i])] = i;
+
+    // Round constants from FNV-1a of the key
+    uint64_t state = 0xcbf29ce484222325ULL;
+    for(char c : key) state = (state ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+    for(unsigned round = 0; round < ROUNDS; ++round) {
+      multipliers_[round] = SplitMix64(state) | 1;
+      addends_[round] = SplitMix64(state);
+      // Newton's iteration doubles the correct low bits, odd m is its own inverse modulo 8
+      uint64_t inverse = multipliers_[round];
+      for(int i = 0; i < 5; ++i) inverse *= 2 - multipliers_[round] * inverse;
+      inverses_[round] = inverse;
+    }
+
+    permuted_bits = (permuted_bits > 63) ? 63 : permuted_bits;
+    mask_ = key.empty() ? 0 : (1ULL << permuted_bits) - 1;
+    shift_ = (permuted_bits + 1) / 2;
+  }
+
+  uint64_t SortableCodec::Permute(uint64_t id) const {
+    // Multiply-add carries low bits up, xorshift brings high bits down; both are bijections on mask_
+    uint64_t x = id & mask_;
+    for(unsigned round = 0; round < ROUNDS; ++round) {
+      x = (x * multipliers_[round] + addends_[round]) & mask_;
+      x ^= x >> shift_;
+    }
+    return (id & ~mask_) | x;
+  }
+
+  uint64_t SortableCodec::Unpermute(uint64_t id) const {
+    uint64_t x = id & mask_;
+    for(unsigned round = ROUNDS; round-- > 0;) {
+      x ^= x >> shift_;
+      x = ((x - addends_[round]) * inverses_[round]) & mask_;
+    }
+    return (id & ~mask_) | x;
+  }
+
+  void SortableCodec::EncodeValue(uint64_t value, char* output) const {
+    if(alphabet_ == BASE64URL) {
+      // Top 4 bits, then ten groups of 6
+      output[0] = digits_[value >> 60];
+      for(unsigned i = 1; i < WIDTH; ++i) output[i] = digits_[(value >> (60 - 6 * i)) & 63];
+      return;
+    }
+    // Constant divisors, so multiplications and shifts
+    uint64_t high = value / CHUNK;
+    uint32_t low = static_cast<uint32_t>(value - high * CHUNK);
+    uint32_t first = static_cast<uint32_t>(high / CHUNK);
+    uint32_t middle = static_cast<uint32_t>(high - first * CHUNK);
+    output[0] = digits_[first];
+    PutChunk(middle, digits_, output + 1);
+    PutChunk(low, digits_, output + 6);
+  }
+
+  bool SortableCodec::DecodeValue(const char* input, uint64_t& value) const {
+    uint32_t invalid = 0;
+    uint64_t first = values_[static_cast<uint8_t>(input[0])];
+    invalid |= first;
+    if(alphabet_ == BASE64URL) {
+      invalid |= static_cast<uint32_t>(first > 15) << 7; // Only 4 bits fit in front of ten groups of 6
+      value = first;
+      for(unsigned i = 1; i < WIDTH; ++i) {
+        uint32_t digit = values_[static_cast<uint8_t>(input[i])];
+        invalid |= digit;
+        value = (value << 6) | (digit & 63);
+      }
+      return !(invalid & INVALID);
+    }
+    uint64_t high = first * CHUNK + GetChunk(values_.data(), input + 1, invalid);
+    uint64_t low = GetChunk(values_.data(), input + 6, invalid);
+    // Keys above UINT64_MAX
+    invalid |= static_cast<uint32_t>((high > MAX_HIGH) | ((high == MAX_HIGH) & (low > MAX_LOW))) << 7;
+    value = high * CHUNK + low;
+    return !(invalid & INVALID);
+  }
+
+  bool SortableCodec::Decode(const char* input, size_t length, uint64_t& id) const {
+    uint64_t value = 0;
+    if(length != WIDTH || !DecodeValue(input, value)) return false;
+    id = Unpermute(value);
+    return true;
+  }
+
+  size_t SortableCodec::EncodeMany(const uint64_t* ids, size_t count, char* output, int delimiter) const {
+    if(delimiter < 0) {
+      for(size_t i = 0; i < count; ++i) Encode(ids[i], output + i * WIDTH);
+      return count * WIDTH;
+    }
+    for(size_t i = 0; i < count; ++i) {
+      Encode(ids[i], output + i * (WIDTH + 1));
+      output[i * (WIDTH + 1) + WIDTH] = static_cast<char>(delimiter);
+    }
+    return count * (WIDTH + 1);
+  }
+
+  size_t SortableCodec::CountMany(size_t length, int delimiter) {
+    if(delimiter < 0) return (length % WIDTH == 0) ? length / WIDTH : 0;
+    if(length % (WIDTH + 1) == 0) return length / (WIDTH + 1);
+    return ((length + 1) % (WIDTH + 1) == 0) ? (length + 1) / (WIDTH + 1) : 0;
+  }
+
+  size_t SortableCodec::DecodeMany(const char* input, size_t length, int delimiter, uint64_t* output, uint8_t* valid) const {
+    size_t count = CountMany(length, delimiter);
+    size_t stride = WIDTH + (delimiter < 0 ? 0 : 1);
+    std::memset(valid, 0, (count + 7) / 8);
+    size_t valid_count = 0;
+    for(size_t i = 0; i < count; ++i) {
+      const char* key = input + i * stride;
+      uint64_t value = 0;
+      bool ok = DecodeValue(key, value);
+      // Delimiter after every key but maybe the last
+      if(delimiter >= 0 && i * stride + WIDTH < length) ok = ok && key[WIDTH] == static_cast<char>(delimiter);
+      output[i] = ok ? Unpermute(value) : 0;
+      valid[i / 8] |= static_cast<uint8_t>(ok) << (i % 8);
+      valid_count += ok;
+    }
+    return valid_count;
+  }
+
+}  // namespace shortduid
+// vim: syntax=cpp11:ts=2:sw=2
@@ -0,0 +1,90 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#ifndef SHORTDUID_SORTABLE_H
+#define SHORTDUID_SORTABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace shortduid {
+
+  //
+  // Fixed width, order preserving text form of IDs: byte-wise (memcmp, C collation) order of keys is numeric order of
+  // IDs, so keys of new IDs land at the end of an index like the IDs themselves. Digits are in ASCII order, most
+  // significant first, padded to WIDTH with the zero digit.
+  //
+  // With a key, the low permuted_bits of every ID (shard and sequence of its layout) go through a keyed bijection
+  // first: light obfuscation of how many IDs a shard hands out per millisecond. The timestamp above them is left
+  // alone, so keys stay ordered by millisecond, and an empty key leaves IDs as they are.
+  //
+  // Encode and decode are table lookups and multiplications without data dependent branches; decode rejects
+  // anything that is not exactly the encoding of some ID.
+  //
+  class SortableCodec {
+  public:
+    enum Alphabet {
+      BASE62,    // 0-9A-Za-z
+      BASE64URL  // -0-9A-Z_a-z, plain bit slicing
+    };
+
+    static const size_t WIDTH = 11; // Characters per key, for either alphabet
+
+    explicit SortableCodec(Alphabet alphabet = BASE62, const std::string& key = "", unsigned permuted_bits = 22);
+
+    Alphabet GetAlphabet() const { return alphabet_; }
+
+    //
+    // Key of id, WIDTH characters to output
+    //
+    void Encode(uint64_t id, char* output) const {
+      EncodeValue(Permute(id), output);
+    }
+
+    //
+    // id of a key of WIDTH characters, false for anything else
+    //
+    bool Decode(const char* input, size_t length, uint64_t& id) const;
+
+    //
+    // count keys back to back into output, count * WIDTH characters, or count * (WIDTH + 1) with a delimiter of 0 to
+    // 255 after every key. Returns the number of characters written.
+    //
+    size_t EncodeMany(const uint64_t* ids, size_t count, char* output, int delimiter = -1) const;
+
+    //
+    // Keys as EncodeMany writes them, the delimiter after the last one is optional. Bit i of the valid bitmap (LSB
+    // first, (count + 7) / 8 bytes) tells whether key i was valid, invalid ones decode to 0. CountMany tells how many
+    // output and valid have to hold, 0 if length does not fit the layout. Returns the number of valid keys.
+    //
+    size_t DecodeMany(const char* input, size_t length, int delimiter, uint64_t* output, uint8_t* valid) const;
+    static size_t CountMany(size_t length, int delimiter);
+
+    //
+    // Plain order preserving encoding without the permutation, e.g. for bounds of a range scan: IDs of a millisecond
+    // permute among themselves, so keys of Generator::MinIdForTime() and MaxIdForTime() this way bound their keys
+    //
+    void EncodeValue(uint64_t value, char* output) const;
+
+    uint64_t Permute(uint64_t id) const;
+    uint64_t Unpermute(uint64_t id) const;
+
+  private:
+    static const unsigned ROUNDS = 3;
+
+    bool DecodeValue(const char* input, uint64_t& value) const;
+
+    Alphabet alphabet_;
+    const char* digits_;              // Digit values to characters
+    std::array<uint8_t, 256> values_; // Characters to digit values, 0xff for foreign ones
+    uint64_t mask_;                   // Permuted bits, 0 without key
+    unsigned shift_;                  // Of the xorshift steps, at least half of the permuted bits so they undo themselves
+    uint64_t multipliers_[ROUNDS];    // Odd, so invertible modulo 2^64
+    uint64_t inverses_[ROUNDS];
+    uint64_t addends_[ROUNDS];
+  };
+
+}  // namespace shortduid
+
+#endif
+// vim: syntax=cpp11:ts=2:sw=2
@@ -0,0 +1,173 @@
+#include "ticker.h"
+
+#include <atomic>
+#include <chrono>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace shortduid {
+
+  const uint32_t Ticker::STALL_CHECK_READS;
+  const uint64_t Ticker::STALL_MS;
+
+  namespace {
+
+    //
+    // Published time sits alone on its cache line, written once per millisecond and read by every generator
+    //
+    struct PublishedTime {
+      char padding_before[64];
+      std::atomic<uint64_t> ms;
+      char padding_after[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    PublishedTime published; // Zero initialized, 0 always reads as stale
+    std::atomic<bool> restart_needed(false);
+
+    // Never destroyed, generators may let go of the ticker after static destructors ran
+    std::mutex& InstanceMutex() {
+      static auto instance_mutex = new std::mutex();
+      return *instance_mutex;
+    }
+
+    std::weak_ptr<Ticker>& Instance() {
+      static auto instance = new std::weak_ptr<Ticker>();
+      return *instance;
+    }
+
+#ifndef _WIN32
+    std::once_flag fork_handler_once;
+    std::shared_ptr<Ticker> forking; // Held from prepare to parent/child handler
+#endif
+
+  }  // namespace
+
+  Ticker::Ticker() : wakeup_(new std::condition_variable()), stop_(false) {
+    Publish(SteadyMs());
+    thread_.reset(new std::thread(&Ticker::Run, this));
+  }
+
+  Ticker::~Ticker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wakeup_->notify_one();
+    if(thread_) thread_->join();
+  }
+
+  std::shared_ptr<Ticker> Ticker::Acquire() {
+#ifndef _WIN32
+    std::call_once(fork_handler_once, []() { pthread_atfork(OnForkPrepare, OnForkParent, OnForkChild); });
+#endif
+    std::lock_guard<std::mutex> lock(InstanceMutex());
+    auto ticker = Instance().lock();
+    if(!ticker) {
+      ticker.reset(new Ticker());
+      Instance() = ticker;
+    }
+    return ticker;
+  }
+
+  uint64_t Ticker::SteadyMs() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  uint64_t Ticker::CoarseMs() {
+#if defined(CLOCK_MONOTONIC_COARSE)
+    timespec ts;
+    if(clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0) return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+#endif
+    return SteadyMs();
+  }
+
+  uint64_t Ticker::Now() {
+    // Previous reading of this thread and how often it came back unchanged. Constant initialized, no TLS guard
+    static thread_local uint64_t last_ms = 0;
+    static thread_local uint32_t unmoved = 0;
+    uint64_t ms = published.ms.load(std::memory_order_relaxed);
+    if(ms != last_ms) {
+      last_ms = ms;
+      unmoved = 0;
+      return ms;
+    }
+    if((unmoved++ & (STALL_CHECK_READS - 1)) == 0) last_ms = ms = CheckStall(ms);
+    return ms;
+  }
+
+  uint64_t Ticker::CheckStall(uint64_t published_ms) {
+    uint64_t ms = SteadyMs();
+    if(ms <= published_ms + STALL_MS) return published_ms;
+
+    // Ticker fell behind, or is gone in a forked child: publish for everyone until it catches up or is back
+    Publish(ms);
+    if(restart_needed.exchange(false)) {
+      std::lock_guard<std::mutex> lock(InstanceMutex());
+      if(auto ticker = Instance().lock()) {
+        std::lock_guard<std::mutex> ticker_lock(ticker->mutex_);
+        ticker->thread_.reset(new std::thread(&Ticker::Run, ticker.get()));
+      }
+    }
+    return ms;
+  }
+
+  void Ticker::Publish(uint64_t ms) {
+    // Direct readings of stalled readers and the ticker race each other, published time only moves forward
+    uint64_t current = published.ms.load(std::memory_order_relaxed);
+    while(current < ms && !published.ms.compare_exchange_weak(current, ms, std::memory_order_relaxed));
+  }
+
+  void Ticker::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(!stop_) {
+      uint64_t ms = SteadyMs();
+      Publish(ms);
+      // Sleep to the next millisecond boundary, waking up early only to stop
+      wakeup_->wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::milliseconds(ms + 1)));
+    }
+  }
+
+#ifndef _WIN32
+  // Fork keeps only the forking thread: nothing may hold our locks at that point, and the child has no ticker thread,
+  // its handle is dropped and a new thread started on the first stall check, not in the handler itself
+  void Ticker::OnForkPrepare() {
+    InstanceMutex().lock();
+    forking = Instance().lock();
+    if(forking) forking->mutex_.lock();
+  }
+
+  void Ticker::OnForkParent() {
+    if(forking) forking->mutex_.unlock();
+    InstanceMutex().unlock();
+    forking.reset();
+  }
+
+  void Ticker::OnForkChild() {
+    if(forking) {
+      // Thread and condition variable of the parent's ticker are abandoned on purpose, once per fork. The thread does
+      // not exist here: joining or detaching its handle is undefined and destroying it joinable terminates. The
+      // condition variable still counts that thread as a waiter, destroying or signalling it may wait for it forever.
+      forking->thread_.release();
+      forking->wakeup_.release();
+      forking->wakeup_.reset(new std::condition_variable());
+      restart_needed = true;
+      forking->mutex_.unlock();
+    }
+    InstanceMutex().unlock();
+    forking.reset();
+  }
+#else
+  void Ticker::OnForkPrepare() {
+  }
+
+  void Ticker::OnForkParent() {
+  }
+
+  void Ticker::OnForkChild() {
+  }
+#endif
+
+}  // namespace shortduid
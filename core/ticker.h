@@ -0,0 +1,63 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#ifndef SHORTDUID_TICKER_H
+#define SHORTDUID_TICKER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace shortduid {
+
+  //
+  // Process wide millisecond clock: a thread publishes steady clock milliseconds on every millisecond boundary and
+  // readers get them with a plain load instead of a clock read. A read that sees the same value as the previous read of
+  // its thread checks it against the steady clock, and after that only every STALL_CHECK_READS-th such read; while the
+  // published value moves nothing is checked. A stalled or, after fork, missing ticker stops moving, so the reader
+  // notices it on its second read, however rarely it reads, and takes over until the ticker catches up or is back. A
+  // busy thread pays one clock read per millisecond. The thread runs while anyone holds on to the ticker.
+  //
+  class Ticker {
+  public:
+    static const uint32_t STALL_CHECK_READS = 64; // Power of two
+    static const uint64_t STALL_MS = 2;           // Behind by more is a stall
+
+    static std::shared_ptr<Ticker> Acquire();
+    ~Ticker();
+
+    Ticker(const Ticker&) = delete;
+    Ticker& operator=(const Ticker&) = delete;
+
+    //
+    // Milliseconds of the steady clock, published by the ticker or read directly
+    //
+    static uint64_t Now();
+    static uint64_t SteadyMs();
+
+    //
+    // Milliseconds of the coarse monotonic clock: cheap, never ahead of SteadyMs() and behind by at most its resolution
+    //
+    static uint64_t CoarseMs();
+
+  private:
+    Ticker();
+
+    void Run();
+    static uint64_t CheckStall(uint64_t published_ms);
+    static void Publish(uint64_t ms);
+    static void OnForkPrepare();
+    static void OnForkParent();
+    static void OnForkChild();
+
+    // Both behind pointers, so that a forked child can abandon the ones of the thread that did not come along
+    std::mutex mutex_;
+    std::unique_ptr<std::condition_variable> wakeup_;
+    bool stop_;
+    std::unique_ptr<std::thread> thread_;
+  };
+
+}  // namespace shortduid
+
+#endif
+// vim: syntax=cpp11:ts=2:sw=2
@@ -10,13 +10,14 @@ var cpus = require( 'os' ).cpus().length;
 app.name = "ShortDUID";
 app.node_id = 0;
 app.nid = process.env.NODE_APP_INSTANCE ? process.env.NODE_APP_INSTANCE : ( cluster.worker.id ? cluster.worker.id : ( process.pid % cpus ) ); //nodejs instance ID
-app.shard_id = app.node_id + app.nid;
+app.shared_shard = process.env.SHARED_SHARD === '1'; //All workers of this host share one shard, state in shared memory
+app.shard_id = app.shared_shard ? app.node_id : app.node_id + app.nid;
 app.port = 45000;
 app.salt = "this is my super secret salt";
 app.epoch_start = 1433116800 * 1000; //Mon, 01 Jun 2015 00:00:00 GMT
 
 //Instantiate short-duid
-var duid_instance = new duid.init( app.shard_id, app.salt, app.epoch_start );
+var duid_instance = new duid.init( app.shard_id, app.salt, app.epoch_start, { shm: app.shared_shard } );
 console.log( "Node with shard_id #" + app.shard_id + " started." );
 
 //Setup routes
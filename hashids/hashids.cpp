@@ -18,6 +18,7 @@
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
+#include <cstring>
 
 namespace hashidsxx {
 
@@ -63,68 +64,312 @@ namespace hashidsxx {
     _guards = _alphabet.substr(0, num_guards);
     _alphabet = _alphabet.substr(num_guards);
     };
+
+  _compile();
   }
 
   Hashids::Hashids(const Hashids &that)
   : _salt(that._salt), _alphabet(that._alphabet),
   _min_length(that._min_length), _separators(that._separators),
-  _guards(that._guards) {
+  _guards(that._guards), _lottery_alphabets(that._lottery_alphabets),
+  _lottery_positions(that._lottery_positions),
+  _padding_left(that._padding_left), _padding_right(that._padding_right),
+  _padding_rounds(that._padding_rounds),
+  _padding_round_count(that._padding_round_count),
+  _padding_guards(that._padding_guards), _char_map(that._char_map),
+  _chunk(that._chunk), _chunk_magic(that._chunk_magic),
+  _chunk_shift(that._chunk_shift), _chunk_digits(that._chunk_digits),
+  _digit_magic(that._digit_magic), _overflow_number(that._overflow_number),
+  _overflow_digit(that._overflow_digit) {
   }
 
   Hashids::Hashids(Hashids &&that)
   : _salt(std::move(that._salt)), _alphabet(std::move(that._alphabet)),
   _min_length(that._min_length), _separators(std::move(that._separators)),
-  _guards(std::move(that._guards)) {
+  _guards(std::move(that._guards)),
+  _lottery_alphabets(std::move(that._lottery_alphabets)),
+  _lottery_positions(std::move(that._lottery_positions)),
+  _padding_left(std::move(that._padding_left)),
+  _padding_right(std::move(that._padding_right)),
+  _padding_rounds(that._padding_rounds),
+  _padding_round_count(std::move(that._padding_round_count)),
+  _padding_guards(that._padding_guards), _char_map(that._char_map),
+  _chunk(that._chunk),
+  _chunk_magic(that._chunk_magic), _chunk_shift(that._chunk_shift),
+  _chunk_digits(that._chunk_digits), _digit_magic(that._digit_magic),
+  _overflow_number(that._overflow_number),
+  _overflow_digit(that._overflow_digit) {
   }
 
   Hashids::~Hashids() {
   }
 
-  std::string &Hashids::_reorder(std::string &input,
-                                 const std::string &salt) const {
-  uint_fast32_t i, j, v, p;
+  void Hashids::_compile() {
+  // Byte values above the alphabet indices are taken by the character classes
+  if (_alphabet.size() >= CHAR_SEPARATOR)
+    throw std::invalid_argument("hashids: alphabet is too long");
+
+  _char_map.fill(CHAR_FOREIGN);
+  for (auto c : _separators)
+    _char_map[(uint8_t)c] = CHAR_SEPARATOR;
+  for (auto c : _guards)
+    _char_map[(uint8_t)c] = CHAR_GUARD;
+  for (std::size_t i = 0; i < _alphabet.size(); ++i)
+    _char_map[(uint8_t)_alphabet[i]] = i;
+
+  // Largest power of the base below 2^32 and its reciprocal for _divide:
+  // with l = ceil(log2(chunk)), magic = floor(2^64 * (2^l - chunk) / chunk) + 1
+  const uint64_t base = _alphabet.size();
+  _chunk = 1;
+  _chunk_digits = 0;
+  while (_chunk * base < (1ULL << 32)) {
+    _chunk *= base;
+    ++_chunk_digits;
+    };
 
-  if (salt.empty() || input.size() > UINT_FAST32_MAX || salt.size() > UINT_FAST32_MAX)
-    return input;
+  unsigned int l = 0;
+  while ((1ULL << l) < _chunk)
+    ++l;
+#if defined(__SIZEOF_INT128__)
+  _chunk_magic = (uint64_t)((((unsigned __int128)((1ULL << l) - _chunk)) << 64) / _chunk) + 1;
+#else
+  _chunk_magic = 0;
+#endif
+  _chunk_shift = l - 1;
+
+  // ceil(2^64 / base): exact quotient for anything below 2^32 straight from
+  // the high half of the product, no correction step
+  _digit_magic = UINT64_MAX / base + 1;
+
+  _overflow_number = UINT64_MAX / base;
+  _overflow_digit = UINT64_MAX % base;
+
+  // With a fixed salt the first reorder of encode/decode only depends on the
+  // lottery character, so do all of them once here instead of on every call
+  _lottery_alphabets.clear();
+  _lottery_alphabets.reserve(_alphabet.size() * _alphabet.size());
+
+  std::string alphabet_salt;
+  std::string alphabet;
+  for (auto lottery : _alphabet) {
+    alphabet_salt.clear();
+    alphabet_salt.push_back(lottery);
+    alphabet_salt.append(_salt)
+                 .append(_alphabet);
+
+    alphabet = _alphabet;
+    _lottery_alphabets.append(_reorder(alphabet, alphabet_salt));
+    };
 
-  for (i = input.length() - 1, v = 0, p = 0; i > 0; --i, ++v) {
-    v %= salt.length();
-    p += salt[v];
-    j = (salt[v] + v + p) % i;
+  // Decode maps characters of the first number through these instead of
+  // searching the row
+  _lottery_positions.assign(_lottery_alphabets.size(), 0);
+  for (std::size_t row = 0; row < _alphabet.size(); ++row) {
+    const char *lottery_alphabet = _lottery_alphabet(row);
+    for (std::size_t i = 0; i < _alphabet.size(); ++i)
+      _lottery_positions[row * _alphabet.size() + _char_map[(uint8_t)lottery_alphabet[i]]] = i;
+    };
 
-    std::swap(input[i], input[j]);
-    }
+  // Padded hashes are at least a digit, the lottery and two guards, so no
+  // hash ever takes more rounds than the shortest one
+  const std::size_t split_at = base / 2;
+  _padding_rounds = (_min_length > 4) ? (_min_length - 4 + base - 1) / base : 0;
+  _padding_round_count.assign(_min_length, 0);
+  for (std::size_t length = 0; length < _min_length; ++length)
+    _padding_round_count[length] = (_min_length - length + base - 1) / base;
+  // values_hash is below 100, characters are -128 to 127 as plain char
+  for (std::size_t i = 0; i < _padding_guards.size(); ++i)
+    _padding_guards[i] = _guards[(uint32_t)((int)i - 128) % _guards.size()];
+
+  _padding_left.assign(base * _padding_rounds * (base - split_at), 0);
+  _padding_right.assign(base * _padding_rounds * split_at, 0);
+
+  std::string padding_salt;
+  for (std::size_t row = 0; row < base && _padding_rounds > 0; ++row) {
+    alphabet.assign(_lottery_alphabet(row), base);
+    char *left = &_padding_left[0] + (row + 1) * _padding_rounds * (base - split_at);
+    char *right = &_padding_right[0] + row * _padding_rounds * split_at;
+    for (std::size_t round = 0; round < _padding_rounds; ++round) {
+      padding_salt = alphabet;
+      _reorder(&alphabet[0], base, padding_salt.data(), base);
+      left -= base - split_at;
+      std::copy(alphabet.begin() + split_at, alphabet.end(), left);
+      right = std::copy(alphabet.begin(), alphabet.begin() + split_at, right);
+      };
+    };
+  }
 
-  return input;
+  std::size_t Hashids::max_length() const {
+  // Lottery character plus digits, or whatever padding asks for
+  char digits[64];
+  std::size_t length = digits + sizeof(digits) -
+                       _digits(UINT64_MAX, _alphabet.data(), digits + sizeof(digits));
+  return std::max<std::size_t>(length + 1, _min_length);
   }
 
-  std::string Hashids::_reorder_norewrite(const std::string &input,
-                                          const std::string &salt) const {
-  auto output(input);
-  return _reorder(output, salt);
+  bool Hashids::valid_alphabet(const std::string &alphabet) {
+  if (alphabet.size() < 16)
+    return false;
+  std::array<bool, 256> seen;
+  seen.fill(false);
+  for (auto c : alphabet) {
+    if ((uint8_t)c <= ' ' || (uint8_t)c >= 0x7f || seen[(uint8_t)c])
+      return false;
+    seen[(uint8_t)c] = true;
+    };
+  return true;
   }
 
-  std::string Hashids::_hash(uint64_t number, const std::string &alphabet) const {
-    std::string output;
-    do {
-      output.insert(std::begin(output), alphabet[number % alphabet.size()]);
-      number /= alphabet.size();
-    } while (number);
-    return output;
+  std::size_t Hashids::encode_one(uint64_t number, char *output) const {
+  const std::size_t base = _alphabet.size();
+  uint32_t values_hash = number % 100;
+  std::size_t lottery_index = values_hash % base;
+  const char *alphabet = _lottery_alphabet(lottery_index);
+
+  char digits[64];
+  char *end = digits + sizeof(digits);
+  char *begin = _digits(number, alphabet, end);
+
+  std::size_t length = end - begin;
+  if (length + 1 >= _min_length) {
+    output[0] = _alphabet[lottery_index];
+    std::copy(begin, end, output + 1);
+    return length + 1;
+    };
+
+  // Guards around the hash, then padding rounds straight from the tables
+  char guarded[sizeof(digits) + 3];
+  std::size_t guarded_length = 0;
+  guarded[guarded_length++] = _padding_guards[values_hash + _alphabet[lottery_index] + 128];
+  guarded[guarded_length++] = _alphabet[lottery_index];
+  guarded_length = std::copy(begin, end, guarded + guarded_length) - guarded;
+  if (guarded_length < _min_length) {
+    guarded[guarded_length] = _padding_guards[values_hash + guarded[2] + 128];
+    ++guarded_length;
+    };
+
+  if (guarded_length >= _min_length) {
+    std::copy(guarded, guarded + guarded_length, output);
+    return guarded_length;
+    };
+
+  const std::size_t split_at = base / 2;
+  std::size_t rounds = _padding_round_count[guarded_length];
+  const char *left = _padding_left.data() + (lottery_index + 1) * _padding_rounds * (base - split_at);
+  const char *right = _padding_right.data() + lottery_index * _padding_rounds * split_at;
+  _center(left - rounds * (base - split_at), rounds * (base - split_at),
+          guarded, guarded_length, right, rounds * split_at, output);
+  return _min_length;
+  }
+
+  void Hashids::_center(const char *left, std::size_t left_length,
+                        const char *middle, std::size_t middle_length,
+                        const char *right, std::size_t right_length,
+                        char *output) const {
+  // Cut of the last padding round: _min_length characters around the middle
+  // of left + middle + right. The last round adds less than a whole alphabet
+  // too much, so the cut always takes all of middle and some of either side
+  std::size_t cut = (left_length + middle_length + right_length - _min_length) / 2;
+  output = std::copy(left + cut, left + left_length, output);
+  output = std::copy(middle, middle + middle_length, output);
+  std::copy(right, right + (_min_length - (left_length - cut) - middle_length), output);
   }
 
-  uint64_t Hashids::_unhash(const std::string &input,
-                            const std::string &alphabet) const {
-  uint64_t output = 0;
-  for (std::string::size_type i = 0; i < input.size(); ++i) {
-    char c = input[i];
-    std::string::size_type pos = alphabet.find(c);
-    output += pos * std::pow(alphabet.size(), input.size() - i - 1);
+  std::size_t Hashids::encode_many(const uint64_t *numbers, std::size_t count,
+                                   char *output, uint32_t *offsets,
+                                   int delimiter) const {
+  char *out = output;
+  if (offsets)
+    *offsets++ = 0;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    out += encode_one(numbers[i], out);
+    if (delimiter >= 0)
+      *out++ = (char)delimiter;
+    if (offsets)
+      *offsets++ = out - output;
     };
 
+  return out - output;
+  }
+
+  char *Hashids::_digits(uint64_t number, const char *alphabet, char *end) const {
+  // Digits come out least significant first, so fill from the back. Members
+  // go to locals first, stores through char * could alias them otherwise.
+  const uint64_t base = _alphabet.size();
+  char *begin = end;
+#if defined(__SIZEOF_INT128__)
+  const uint64_t chunk_base = _chunk;
+  const uint64_t chunk_magic = _chunk_magic;
+  const unsigned int chunk_shift = _chunk_shift;
+  const unsigned int chunk_digits = _chunk_digits;
+  const uint64_t digit_magic = _digit_magic;
+
+  while (number >= chunk_base) {
+    uint64_t quotient = _divide(number, chunk_base, chunk_magic, chunk_shift);
+    uint64_t chunk = number - quotient * chunk_base;
+    number = quotient;
+    for (unsigned int i = 0; i < chunk_digits; ++i) {
+      uint64_t digit_quotient = (uint64_t)(((unsigned __int128)chunk * digit_magic) >> 64);
+      *--begin = alphabet[chunk - digit_quotient * base];
+      chunk = digit_quotient;
+      };
+    };
+
+  // Whatever is left is below 2^32 too
+  do {
+    uint64_t digit_quotient = (uint64_t)(((unsigned __int128)number * digit_magic) >> 64);
+    *--begin = alphabet[number - digit_quotient * base];
+    number = digit_quotient;
+  } while (number);
+#else
+  do {
+    *--begin = alphabet[number % base];
+    number /= base;
+  } while (number);
+#endif
+  return begin;
+  }
+
+  std::string Hashids::encode_one(uint64_t number) const {
+  std::string output(max_length(), '\0');
+  output.resize(encode_one(number, &output[0]));
   return output;
   }
 
+  std::string &Hashids::_reorder(std::string &input,
+                                 const std::string &salt) const {
+  if (input.size() > UINT_FAST32_MAX || salt.size() > UINT_FAST32_MAX)
+    return input;
+
+  _reorder(&input[0], input.size(), salt.data(), salt.size());
+  return input;
+  }
+
+  void Hashids::_reorder(char *input, std::size_t length, const char *salt,
+                         std::size_t salt_length) const {
+  uint_fast32_t i, j, v, p;
+
+  if (salt_length == 0 || length < 2)
+    return;
+
+  for (i = length - 1, v = 0, p = 0; i > 0; --i, ++v) {
+    v %= salt_length;
+    p += salt[v];
+    j = (salt[v] + v + p) % i;
+
+    std::swap(input[i], input[j]);
+    }
+  }
+
+  std::string Hashids::_hash(uint64_t number, const std::string &alphabet) const {
+    // Digits fill a buffer from the back instead of being inserted at the
+    // front of the string one at a time
+    char digits[64];
+    char *end = digits + sizeof(digits);
+    return std::string(_digits(number, alphabet.data(), end), end);
+  }
+
   void Hashids::_ensure_length(std::string &output, std::string &alphabet,
                                uint32_t values_hash) const {
   uint32_t guard_index = (values_hash + output[0]) % _guards.size();
@@ -135,69 +380,210 @@ namespace hashidsxx {
     output.push_back(_guards[guard_index]);
     };
 
-  uint32_t split_at = alphabet.size() / 2;
-  while (output.size() < _min_length) {
-    alphabet = _reorder_norewrite(alphabet, alphabet);
+  if (output.size() >= _min_length)
+    return;
+
+  // Same rounds as encode_one takes from its tables, on whatever alphabet the
+  // last number left behind: halves collected once, cut once at the end
+  const std::size_t base = alphabet.size();
+  const std::size_t split_at = base / 2;
+  std::size_t rounds = (_min_length - output.size() + base - 1) / base;
+  std::string left(rounds * (base - split_at), '\0'), right, salt;
+  right.reserve(rounds * split_at);
+  for (std::size_t round = 0; round < rounds; ++round) {
+    salt = alphabet;
+    _reorder(&alphabet[0], base, salt.data(), base);
+    std::copy(alphabet.begin() + split_at, alphabet.end(), &left[0] + (rounds - round - 1) * (base - split_at));
+    right.append(alphabet, 0, split_at);
+    };
 
-    output = alphabet.substr(split_at) + output + alphabet.substr(0, split_at);
+  std::string padded(_min_length, '\0');
+  _center(left.data(), left.size(), output.data(), output.size(), right.data(), right.size(), &padded[0]);
+  output.swap(padded);
+  }
 
-    uint32_t excess = output.size() - _min_length;
-    if (excess > 0) {
-      auto from_index = excess / 2;
-      output = output.substr(from_index, _min_length);
+  bool Hashids::_canonical(const char *input, std::size_t length,
+                           const uint64_t *numbers, std::size_t count) const {
+  if (count == 1) {
+    // Room for the longest padding the binding allows
+    char encoded[1088];
+    if (max_length() <= sizeof(encoded)) {
+      std::size_t encoded_length = encode_one(numbers[0], encoded);
+      return encoded_length == length && std::equal(input, input + length, encoded);
       };
+    auto long_encoded = encode_one(numbers[0]);
+    return long_encoded.size() == length && std::equal(input, input + length, long_encoded.data());
     };
-  }
 
-  std::vector<std::string> Hashids::_split(const std::string &input,
-                                           const std::string &splitters) const {
-  std::vector<std::string> parts;
-  std::string tmp;
+  auto encoded = encode(numbers, numbers + count);
+  return encoded.size() == length && std::equal(input, input + length, encoded.data());
+  }
 
-  for (auto c : input) {
-    if (splitters.find(c) != std::string::npos) {
-        parts.push_back(tmp);
-        tmp.clear();
+  std::size_t Hashids::decode(const char *input, std::size_t length,
+                              uint64_t *output, std::size_t capacity) const {
+  // Same part selection as the classic split on guards: the part after the
+  // first guard, unless that one is empty and there is nothing after it
+  const char *hashid = input;
+  const char *hashid_end = input + length;
+  std::size_t guards = 0;
+  for (const char *c = input; c != input + length; ++c) {
+    uint8_t mapped = _char_map[(uint8_t)*c];
+    if (mapped == CHAR_FOREIGN)
+      return 0;
+    if (mapped != CHAR_GUARD)
+      continue;
+
+    if (++guards == 1) {
+      if (c + 1 != input + length) {
+        hashid = c + 1;
       } else {
-        tmp.push_back(c);
-      }
+        hashid_end = c;
+        };
+      } else if (guards == 2) {
+      hashid_end = c;
+      };
     };
-  if (!tmp.empty())
-    parts.push_back(tmp);
 
-  return parts;
-  }
+  if (hashid >= hashid_end)
+    return 0;
+
+  const std::size_t base = _alphabet.size();
+  uint8_t lottery_index = _char_map[(uint8_t)*hashid];
+  if (lottery_index >= base)
+    return 0;
+
+  const uint8_t *positions = (const uint8_t *)_lottery_positions.data() + lottery_index * base;
+  const uint64_t overflow_number = _overflow_number;
+  const uint64_t overflow_digit = _overflow_digit;
+  char alphabet[CHAR_SEPARATOR];
+
+  std::size_t count = 0;
+  const char *part = hashid + 1;
+  while (part <= hashid_end) {
+    const char *part_end = part;
+    while (part_end != hashid_end && _char_map[(uint8_t)*part_end] != CHAR_SEPARATOR)
+      ++part_end;
+
+    if (part == part_end || count == capacity)
+      return 0;
+
+    uint8_t alphabet_positions[CHAR_SEPARATOR];
+    if (count > 0) {
+      if (count == 1)
+        std::copy(_lottery_alphabet(lottery_index), _lottery_alphabet(lottery_index) + base, alphabet);
+
+      // Every following number reorders the previous alphabet again, salt is
+      // the same as encode uses, cut to the alphabet size
+      char alphabet_salt[CHAR_SEPARATOR];
+      std::size_t salt_length = 0;
+      alphabet_salt[salt_length++] = *hashid;
+      salt_length += _salt.copy(alphabet_salt + salt_length, base - salt_length);
+      std::copy(alphabet, alphabet + (base - salt_length), alphabet_salt + salt_length);
+
+      _reorder(alphabet, base, alphabet_salt, base);
+      for (std::size_t i = 0; i < base; ++i)
+        alphabet_positions[_char_map[(uint8_t)alphabet[i]]] = i;
+      positions = alphabet_positions;
+      };
 
-  std::vector<uint64_t> Hashids::decode(const std::string &input) const {
-  std::vector<uint64_t> output;
+    uint64_t number = 0;
+    for (const char *c = part; c != part_end; ++c) {
+      uint8_t mapped = _char_map[(uint8_t)*c];
+      if (mapped >= base)
+        return 0;
 
-  auto parts = _split(input, _guards);
+      uint64_t digit = positions[mapped];
+      if (number > overflow_number || (number == overflow_number && digit > overflow_digit))
+        return 0; // Would not fit in 64 bits
+      number = number * base + digit;
+      };
 
-  auto hashid = parts[0];
-  if (parts.size() >= 2)
-    hashid = parts[1];
+    output[count++] = number;
+    part = part_end + 1;
+    };
 
-  if (hashid.empty())
-    return output;
+  // Reject everything encode would not have produced, so equivalent
+  // spellings of the same numbers can not sneak through. An unpadded single
+  // number is canonical when encode would not have padded it, picked the same
+  // lottery and wrote no leading zero, which is cheaper than encoding again.
+  if (count == 1 && guards == 0) {
+    const char *digits = hashid + 1;
+    return length >= _min_length &&
+           lottery_index == (output[0] % 100) % base &&
+           (hashid_end - digits == 1 || positions[_char_map[(uint8_t)*digits]] != 0) ? 1 : 0;
+    };
 
-  output.reserve(parts.size());
+  return _canonical(input, length, output, count) ? count : 0;
+  }
 
-  char lottery = hashid[0];
-  auto alphabet(_alphabet);
+  std::vector<uint64_t> Hashids::decode(const std::string &input) const {
+  // Every number takes at least one character plus a separator
+  std::vector<uint64_t> output(input.size() / 2 + 1);
+  output.resize(decode(input.data(), input.size(), output.data(), output.size()));
+  return output;
+  }
 
-  hashid.erase(std::begin(hashid));
+  std::size_t Hashids::decode_many(const char *input, std::size_t length,
+                                   const uint32_t *offsets, std::size_t count,
+                                   uint64_t *output, uint8_t *valid) const {
+  std::fill(valid, valid + (count + 7) / 8, 0);
+
+  std::size_t valid_count = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    uint32_t begin = offsets[i], end = offsets[i + 1];
+    if (begin <= end && end <= length && decode(input + begin, end - begin, output + i, 1) == 1) {
+      valid[i / 8] |= 1 << (i % 8);
+      ++valid_count;
+    } else {
+      output[i] = 0;
+      };
+    };
 
-  auto hash_parts = _split(hashid, _separators);
-  for (const std::string &part : hash_parts) {
-    auto alphabet_salt = (lottery + _salt + alphabet);
-    alphabet_salt = alphabet_salt.substr(0, alphabet.size());
+  return valid_count;
+  }
 
-    alphabet = _reorder(alphabet, alphabet_salt);
+  std::size_t Hashids::decode_many(const char *input, std::size_t length,
+                                   char delimiter, uint64_t *output,
+                                   uint8_t *valid) const {
+  std::size_t count = count_delimited(input, length, delimiter);
+  std::fill(valid, valid + (count + 7) / 8, 0);
+
+  const char *end = input + length;
+  std::size_t valid_count = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const char *line_end = (const char *)std::memchr(input, delimiter, end - input);
+    if (!line_end)
+      line_end = end;
+
+    std::size_t line_length = line_end - input;
+    if (line_length > 0 && input[line_length - 1] == '\r')
+      --line_length;
+
+    if (decode(input, line_length, output + i, 1) == 1) {
+      valid[i / 8] |= 1 << (i % 8);
+      ++valid_count;
+    } else {
+      output[i] = 0;
+      };
 
-    output.push_back(_unhash(part, alphabet));
+    input = line_end + 1;
     };
 
-  return output;
+  return valid_count;
+  }
+
+  std::size_t Hashids::count_delimited(const char *input, std::size_t length,
+                                       char delimiter) {
+  std::size_t count = 0;
+  const char *end = input + length;
+  while (input != end) {
+    const char *line_end = (const char *)std::memchr(input, delimiter, end - input);
+    ++count;
+    if (!line_end)
+      break;
+    input = line_end + 1;
+    };
+  return count;
   }
 };
 // vim: syntax=cpp11:ts=2:sw=2
@@ -14,11 +14,13 @@
 #  include <type_traits>
 #endif
 
+#include <array>
 #include <string>
 #include <vector>
 #include <stdexcept>
 #include <cmath>
 #include <future>
+#include <iterator>
 
 // For C++11 we use cstdint here, use stdint.h if you want to be able
 // to link to this file with non C++11 as well
@@ -49,6 +51,69 @@ private:
   std::string _separators;
   std::string _guards;
 
+/**
+ *  Precompiled alphabets, one row of _alphabet.size() characters per possible
+ *  lottery character. Row i is _alphabet shuffled with the salt that encode
+ *  would build for lottery _alphabet[i], which is all the first (and for single
+ *  numbers the only) number ever needs.
+ */
+  std::string _lottery_alphabets;
+
+/**
+ *  Inverse of _lottery_alphabets: position of _alphabet[j] in row i
+ */
+  std::string _lottery_positions;
+
+/**
+ *  Padding of single numbers up to _min_length. Every padding round wraps the
+ *  hash in the halves of its alphabet, reordered by itself once per round,
+ *  and for encode_one that alphabet starts out as the lottery row. So all
+ *  rounds are known up front: per row, _padding_rounds left halves, last
+ *  round first, and as many right halves, first round first. k rounds are the
+ *  tail of the left and the head of the right row.
+ */
+  std::string _padding_left;
+  std::string _padding_right;
+  std::size_t _padding_rounds;
+
+/**
+ *  Rounds a guarded hash of each length below _min_length takes, and the
+ *  guard for every values_hash + character + 128 that padding can ask for,
+ *  so padding does not divide
+ */
+  std::vector<uint32_t> _padding_round_count;
+  std::array<char, 356> _padding_guards;
+
+/**
+ *  Reverse lookup for every byte, index into _alphabet or one of the
+ *  CHAR_* classes below
+ */
+  std::array<uint8_t, 256> _char_map;
+
+  enum : uint8_t {
+    CHAR_SEPARATOR = 0xfd,
+    CHAR_GUARD = 0xfe,
+    CHAR_FOREIGN = 0xff
+  };
+
+/**
+ *  Digit conversion: numbers are cut into chunks of _chunk_digits digits
+ *  (_chunk = base^_chunk_digits, below 2^32) with one reciprocal division
+ *  each, digits of a chunk then take a single multiply by _digit_magic
+ */
+  uint64_t _chunk;
+  uint64_t _chunk_magic;
+  unsigned int _chunk_shift;
+  unsigned int _chunk_digits;
+  uint64_t _digit_magic;
+
+/**
+ *  Decoding overflows 64 bits exactly when the number so far is above
+ *  _overflow_number, or equal to it and the next digit above _overflow_digit
+ */
+  uint64_t _overflow_number;
+  uint64_t _overflow_digit;
+
 public:
   Hashids(const std::string &salt = "", unsigned int min_length = 0,
           const std::string &alphabet = DEFAULT_ALPHABET);
@@ -78,8 +143,11 @@ public:
     if (begin == end)
     return "";
 
-    // Make a copy of our alphabet so we can reorder it on the fly etc
-    auto alphabet(_alphabet);
+    // Single numbers never need an on the fly reorder
+    if (std::next(begin) == end)
+    return encode_one(*begin);
+
+    std::string alphabet;
 
     int values_hash = 0;
     int i = 0;
@@ -88,7 +156,8 @@ public:
       ++i;
     };
 
-    auto encoded = _alphabet[values_hash % _alphabet.size()];
+    auto lottery_index = values_hash % _alphabet.size();
+    auto encoded = _alphabet[lottery_index];
     auto lottery = encoded;
 
     std::string output;
@@ -100,12 +169,16 @@ public:
     for (auto iter = begin; iter != end; ++iter) {
       uint64_t number = *iter;
 
-      std::string alphabet_salt;
-      alphabet_salt.push_back(lottery);
-      alphabet_salt.append(_salt)
-                   .append(alphabet);
+      if (i == 0) {
+        alphabet.assign(_lottery_alphabet(lottery_index), _alphabet.size());
+      } else {
+        std::string alphabet_salt;
+        alphabet_salt.push_back(lottery);
+        alphabet_salt.append(_salt)
+                     .append(alphabet);
 
-      alphabet = _reorder(alphabet, alphabet_salt);
+        alphabet = _reorder(alphabet, alphabet_salt);
+      }
 
       std::string last = _hash(number, alphabet);
       output.append(last);
@@ -122,18 +195,107 @@ public:
     return output;
   }
 
+/**
+ *  Encode a single number into output, which must hold at least
+ *  max_length() characters, padded to the minimum length from tables built
+ *  at construction. Does not allocate. Returns the number of characters
+ *  written.
+ */
+  std::size_t encode_one(uint64_t number, char *output) const;
+  std::string encode_one(uint64_t number) const;
+
+/**
+ *  Encode count independent numbers, one hash each, back to back into
+ *  output, which must hold count * max_length() characters (one more per
+ *  number with a delimiter). Unless null, offsets receives count + 1 entries:
+ *  where every hash starts and, last, the total length. A delimiter of 0 to
+ *  255 is written after every hash. Returns the number of characters written.
+ */
+  std::size_t encode_many(const uint64_t *numbers, std::size_t count,
+                          char *output, uint32_t *offsets = nullptr,
+                          int delimiter = -1) const;
+
+/**
+ *  Upper bound of characters encode_one can produce
+ */
+  std::size_t max_length() const;
+
+/**
+ *  Whether alphabet is usable as is: at least 16 unique printable ASCII
+ *  characters, no spaces. The constructor quietly falls back to
+ *  DEFAULT_ALPHABET for too short ones and does not check the rest
+ */
+  static bool valid_alphabet(const std::string &alphabet);
+
+/**
+ *  Decode input into at most capacity numbers without allocating. Anything
+ *  that is not the canonical encoding of its numbers (foreign characters,
+ *  overflow, bad padding, ...) is rejected. Returns the number of values
+ *  written, 0 for invalid input or input holding more than capacity numbers.
+ */
+  std::size_t decode(const char *input, std::size_t length, uint64_t *output,
+                     std::size_t capacity) const;
+  bool decode_one(const char *input, std::size_t length, uint64_t &output) const {
+    return decode(input, length, &output, 1) == 1;
+  }
+
   std::vector<uint64_t> decode(const std::string &input) const;
 
+/**
+ *  Decode count single number hashes into output[0 .. count), hash i spans
+ *  input[offsets[i] .. offsets[i + 1]). Bit i of the valid bitmap (LSB
+ *  first, (count + 7) / 8 bytes) tells whether hash i was valid, invalid ones
+ *  decode to 0. Returns the number of valid hashes.
+ */
+  std::size_t decode_many(const char *input, std::size_t length,
+                          const uint32_t *offsets, std::size_t count,
+                          uint64_t *output, uint8_t *valid) const;
+
+/**
+ *  Same for hashes separated by delimiter, a trailing \r before it is
+ *  ignored. Text after the last delimiter is one more hash unless empty,
+ *  count_delimited tells how many output and valid have to hold.
+ */
+  std::size_t decode_many(const char *input, std::size_t length,
+                          char delimiter, uint64_t *output,
+                          uint8_t *valid) const;
+  static std::size_t count_delimited(const char *input, std::size_t length,
+                                     char delimiter);
+
 private:
+  void _compile();
+  const char *_lottery_alphabet(std::size_t lottery_index) const {
+    return _lottery_alphabets.data() + lottery_index * _alphabet.size();
+  }
+
+/**
+ *  number / divisor as multiply and shift, the way a compiler does it for a
+ *  constant divisor (round-up method with add indicator)
+ */
+  static uint64_t _divide(uint64_t number, uint64_t divisor, uint64_t magic,
+                          unsigned int shift) {
+#if defined(__SIZEOF_INT128__)
+    uint64_t t = (uint64_t)(((unsigned __int128)number * magic) >> 64);
+    (void)divisor;
+    return (t + ((number - t) >> 1)) >> shift;
+#else
+    (void)magic;
+    (void)shift;
+    return number / divisor;
+#endif
+  }
+  char *_digits(uint64_t number, const char *alphabet, char *end) const;
   std::string &_reorder(std::string &input, const std::string &salt) const;
-  std::string _reorder_norewrite(const std::string &input,
-                                 const std::string &salt) const;
+  void _reorder(char *input, std::size_t length, const char *salt,
+                std::size_t salt_length) const;
   std::string _hash(uint64_t number, const std::string &alphabet) const;
-  uint64_t _unhash(const std::string &input, const std::string &alphabet) const;
   void _ensure_length(std::string &output, std::string &alphabet,
                       uint32_t values_hash) const;
-  std::vector<std::string> _split(const std::string &hash,
-                                  const std::string &splitters) const;
+  void _center(const char *left, std::size_t left_length, const char *middle,
+               std::size_t middle_length, const char *right,
+               std::size_t right_length, char *output) const;
+  bool _canonical(const char *input, std::size_t length,
+                  const uint64_t *numbers, std::size_t count) const;
   };
 };
 // vim: syntax=cpp11:ts=2:sw=2
@@ -1,3 +1,70 @@
 var short_duid = require( 'bindings' )( 'shortduid' );
+var Readable = require( 'stream' ).Readable;
+var util = require( 'util' );
 
-exports.init = short_duid.ShortDUID;
+var ShortDUID = short_duid.ShortDUID;
+
+//
+// Readable of binary chunks filled by the native generator, no JS value per ID. Every chunk is cut to the sequence
+// budget left in the current millisecond and the stream waits for the next one once that is used up, so a long stream
+// runs at the 4096 IDs/ms sequence limit instead of borrowing from future milliseconds.
+//
+function IDStream( instance, options ) {
+  options = options || {};
+  var format = ( options.format === undefined ) ? 'int' : options.format;
+  if ( format !== 'int' && format !== 'hashid' ) {
+    throw new TypeError( "createIDStream: format must be 'int' or 'hashid'" );
+  }
+  var chunk_size = Math.abs( options.chunkSize | 0 ) || 4096;
+  chunk_size = ( chunk_size > 65536 ) ? 4096 : chunk_size; // Check boundaries
+
+  Readable.call( this, { highWaterMark: options.highWaterMark } );
+  this._instance = instance;
+  this._format = format;
+  this._chunk_size = chunk_size;
+  this._remaining = ( options.count === undefined ) ? Infinity : Math.max( 0, Math.floor( options.count ) );
+  this._timer = null;
+}
+util.inherits( IDStream, Readable );
+
+IDStream.prototype._read = function () {
+  if ( this._timer ) return;
+  if ( this._remaining === 0 ) {
+    this.push( null );
+    return;
+  }
+
+  var budget = this._instance.getSequenceBudget();
+  if ( budget === 0 ) {
+    var self = this;
+    this._timer = setTimeout( function () {
+      self._timer = null;
+      self._read();
+    }, Math.max( this._instance.getDriftMs(), 1 ) );
+    return;
+  }
+
+  var cnt = Math.min( this._chunk_size, this._remaining, budget );
+  this._remaining -= cnt;
+  if ( this._format === 'int' ) {
+    var buffer = Buffer.allocUnsafe( cnt * 8 );
+    this._instance.fillDUIDInt( buffer );
+    this.push( buffer );
+  } else {
+    var ids = new BigUint64Array( cnt );
+    this._instance.fillDUIDInt( ids );
+    this.push( this._instance.encodeMany( ids, '\n' ) );
+  }
+};
+
+IDStream.prototype._destroy = function ( err, callback ) {
+  clearTimeout( this._timer );
+  this._timer = null;
+  callback( err );
+};
+
+ShortDUID.prototype.createIDStream = function ( options ) {
+  return new IDStream( this, options );
+};
+
+exports.init = ShortDUID;
@@ -0,0 +1,297 @@
+// vim: syntax=cpp11:ts=2:sw=2
+//
+// Load generator for shortduid_server. Keeps --pipeline requests of --count IDs in flight on each of --connections
+// connections for --duration seconds, then reports requests/s, IDs/s and request latency percentiles; fails if the
+// server leaves requests unanswered for 5 s after that. --self serves from an in-process server on a loopback port
+// instead, --http sends GET /duid and /nduid instead of the binary protocol.
+//
+// Usage: shortduid_loadgen [--connect <host:port> | --unix <path> | --self] [--connections <n>] [--pipeline <n>]
+//                          [--count <n>] [--format int|hashid] [--duration <s>] [--http]
+//
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "generator.h"
+#include "hashids.h"
+#include "protocol.h"
+#include "server.h"
+
+namespace {
+
+  typedef std::chrono::steady_clock Clock;
+
+  const int64_t GRACE_MS = 5000; // Requests in flight after --duration have this long to come back, then the run fails
+
+  struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 6512;
+    std::string unix_path;
+    bool self = false;
+    bool http = false;
+    bool hashid = false;
+    uint32_t connections = 4;
+    uint32_t pipeline = 16;
+    uint32_t count = 1;
+    double duration_s = 5;
+  };
+
+  struct Client {
+    int fd;
+    std::vector<unsigned char> in;
+    std::string out;
+    size_t out_pos;
+    std::deque<Clock::time_point> sent; // Responses come back in order, so do their send times
+  };
+
+  int Connect(const Options& options) {
+    int fd = -1;
+    if(!options.unix_path.empty()) {
+      sockaddr_un address;
+      std::memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      std::strncpy(address.sun_path, options.unix_path.c_str(), sizeof(address.sun_path) - 1);
+      fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if(fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+      }
+    } else {
+      addrinfo hints, *addresses = nullptr;
+      std::memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      if(getaddrinfo(options.host.c_str(), std::to_string(options.port).c_str(), &hints, &addresses) != 0) return -1;
+      fd = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+      if(fd >= 0 && connect(fd, addresses->ai_addr, addresses->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+      }
+      freeaddrinfo(addresses);
+      int on = 1;
+      if(fd >= 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    if(fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+  }
+
+  std::string Request(const Options& options) {
+    if(options.http) {
+      return std::string(options.hashid ? "GET /duid/" : "GET /nduid/") + std::to_string(options.count) + " HTTP/1.1\r\nHost: shortduid\r\n\r\n";
+    }
+    using namespace shortduid::protocol;
+    unsigned char header[HEADER_SIZE];
+    PutHeader(header, { (uint8_t) (options.hashid ? OP_HASHID : OP_INT), VERSION, 0, options.count });
+    return std::string(reinterpret_cast<char*>(header), HEADER_SIZE);
+  }
+
+  //
+  // Length of the complete response at the front of data, 0 if it is not all there yet
+  //
+  size_t ResponseLength(const Options& options, const unsigned char* data, size_t len) {
+    if(!options.http) {
+      using namespace shortduid::protocol;
+      if(len < HEADER_SIZE) return 0;
+      Header header = GetHeader(data);
+      if(header.version_or_status != STATUS_OK) {
+        std::fprintf(stderr, "server answered status %u\n", (unsigned) header.version_or_status);
+        std::exit(1);
+      }
+      return (len >= HEADER_SIZE + header.count_or_length) ? HEADER_SIZE + header.count_or_length : 0;
+    }
+    const char* begin = reinterpret_cast<const char*>(data);
+    for(size_t i = 3; i < len; ++i) {
+      if(begin[i] == '\n' && begin[i - 1] == '\r' && begin[i - 2] == '\n' && begin[i - 3] == '\r') {
+        std::string head(begin, i + 1);
+        size_t field = head.find("Content-Length: ");
+        size_t body = (field != std::string::npos) ? std::strtoul(head.c_str() + field + 16, nullptr, 10) : 0;
+        return (len >= i + 1 + body) ? i + 1 + body : 0;
+      }
+    }
+    return 0;
+  }
+
+  double Percentile(const std::vector<double>& sorted, double p) {
+    if(sorted.empty()) return 0;
+    size_t rank = std::min(sorted.size() - 1, (size_t) (p / 100 * sorted.size()));
+    return sorted[rank];
+  }
+
+  int Usage(const char* name) {
+    std::fprintf(stderr, "Usage: %s [--connect <host:port> | --unix <path> | --self] [--connections <n>] [--pipeline <n>]\n"
+                         "       %*s [--count <n>] [--format int|hashid] [--duration <s>] [--http]\n", name, (int) std::strlen(name), "");
+    return 1;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  for(int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--connect") && has_value) {
+      std::string address(argv[++i]);
+      size_t colon = address.rfind(':');
+      if(colon == std::string::npos) return Usage(argv[0]);
+      options.host = address.substr(0, colon);
+      options.port = (uint16_t) std::strtoul(address.c_str() + colon + 1, nullptr, 10);
+    } else if(!std::strcmp(argv[i], "--unix") && has_value) {
+      options.unix_path = argv[++i];
+    } else if(!std::strcmp(argv[i], "--self")) {
+      options.self = true;
+    } else if(!std::strcmp(argv[i], "--http")) {
+      options.http = true;
+    } else if(!std::strcmp(argv[i], "--connections") && has_value) {
+      options.connections = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+    } else if(!std::strcmp(argv[i], "--pipeline") && has_value) {
+      options.pipeline = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+    } else if(!std::strcmp(argv[i], "--count") && has_value) {
+      options.count = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+    } else if(!std::strcmp(argv[i], "--format") && has_value) {
+      ++i;
+      if(std::strcmp(argv[i], "int") && std::strcmp(argv[i], "hashid")) return Usage(argv[0]);
+      options.hashid = !std::strcmp(argv[i], "hashid");
+    } else if(!std::strcmp(argv[i], "--duration") && has_value) {
+      options.duration_s = std::atof(argv[++i]);
+    } else {
+      return Usage(argv[0]);
+    }
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  // --self: server on its own thread, same process, loopback TCP
+  hashidsxx::Hashids hash("", 0, DEFAULT_ALPHABET);
+  std::unique_ptr<shortduid::Server> server;
+  std::thread server_thread;
+  if(options.self) {
+    try {
+      server.reset(new shortduid::Server(std::make_shared<shortduid::Generator>(), hash));
+      options.host = "127.0.0.1";
+      options.port = server->ListenTcp(options.host, 0);
+      options.unix_path.clear();
+    } catch(const std::exception& e) {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+    }
+    server_thread = std::thread([&]() { server->Run(); });
+  }
+
+  std::vector<Client> clients(options.connections);
+  std::string request(Request(options));
+  for(auto& client : clients) {
+    client.fd = Connect(options);
+    if(client.fd < 0) {
+      std::fprintf(stderr, "can not connect to %s: %s\n", options.unix_path.empty() ? (options.host + ":" + std::to_string(options.port)).c_str() : options.unix_path.c_str(), std::strerror(errno));
+      return 1;
+    }
+    client.out_pos = 0;
+  }
+
+  std::vector<double> latencies_us;
+  uint64_t responses = 0;
+  Clock::time_point start = Clock::now();
+  Clock::time_point end = start + std::chrono::microseconds((int64_t) (options.duration_s * 1e6));
+  Clock::time_point deadline = end + std::chrono::milliseconds(GRACE_MS);
+  bool sending = true;
+  std::vector<pollfd> fds(clients.size());
+  size_t in_flight = 0;
+
+  for(auto& client : clients) {
+    for(uint32_t i = 0; i < options.pipeline; ++i) {
+      client.out += request;
+      client.sent.push_back(start);
+    }
+    in_flight += options.pipeline;
+  }
+
+  // After the duration nothing new is sent, the requests in flight are still waited for until the deadline. A server
+  // that stops answering fails the run instead of hanging it; std::exit, a --self server thread can not be joined then
+  while(in_flight > 0) {
+    for(size_t i = 0; i < clients.size(); ++i) {
+      fds[i].fd = clients[i].fd;
+      fds[i].events = POLLIN | ((clients[i].out_pos < clients[i].out.size()) ? POLLOUT : 0);
+      fds[i].revents = 0;
+    }
+    int64_t left_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+    if(poll(fds.data(), fds.size(), (int) std::max<int64_t>(std::min<int64_t>(left_ms, 1000), 0)) < 0 && errno != EINTR) break;
+    Clock::time_point now = Clock::now();
+    if(now >= deadline) {
+      std::fprintf(stderr, "%zu requests unanswered %.1f s after the end of the run\n", in_flight, GRACE_MS / 1000.0);
+      std::exit(1);
+    }
+    sending = sending && now < end;
+
+    for(size_t i = 0; i < clients.size(); ++i) {
+      Client& client = clients[i];
+      if(fds[i].revents & POLLOUT) {
+        ssize_t sent = send(client.fd, client.out.data() + client.out_pos, client.out.size() - client.out_pos, 0);
+        if(sent > 0) client.out_pos += sent;
+        if(client.out_pos == client.out.size()) {
+          client.out.clear();
+          client.out_pos = 0;
+        }
+      }
+      if(!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+      unsigned char buf[64 * 1024];
+      ssize_t received = recv(client.fd, buf, sizeof(buf), 0);
+      if(received <= 0) {
+        if(received < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        std::fprintf(stderr, "connection closed by server\n");
+        std::exit(1);
+      }
+      client.in.insert(client.in.end(), buf, buf + received);
+
+      size_t pos = 0;
+      while(size_t length = ResponseLength(options, client.in.data() + pos, client.in.size() - pos)) {
+        pos += length;
+        latencies_us.push_back(std::chrono::duration<double, std::micro>(now - client.sent.front()).count());
+        client.sent.pop_front();
+        ++responses;
+        --in_flight;
+        if(sending) {
+          client.out += request;
+          client.sent.push_back(now);
+          ++in_flight;
+        }
+      }
+      client.in.erase(client.in.begin(), client.in.begin() + pos);
+    }
+  }
+  double elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+  for(auto& client : clients) close(client.fd);
+  if(server) {
+    server->Stop();
+    server_thread.join();
+  }
+
+  std::sort(latencies_us.begin(), latencies_us.end());
+  std::printf("%s %s, %u connections x %u pipelined, %u IDs per request\n", options.http ? "http" : "binary", options.hashid ? "hashid" : "int",
+              options.connections, options.pipeline, options.count);
+  std::printf("%llu requests in %.2f s: %.0f requests/s, %.0f IDs/s\n", (unsigned long long) responses, elapsed_s, responses / elapsed_s,
+              (double) responses * options.count / elapsed_s);
+  std::printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", Percentile(latencies_us, 50), Percentile(latencies_us, 90),
+              Percentile(latencies_us, 99), Percentile(latencies_us, 99.9), latencies_us.empty() ? 0 : latencies_us.back());
+  return responses > 0 ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+// vim: syntax=cpp11:ts=2:sw=2
+//
+// Standalone ID server, see server/server.h and server/protocol.h. Without --listen or --unix it listens on
+// 127.0.0.1:6512.
+//
+// Usage: shortduid_server [--shard <id>] [--salt <salt>] [--epoch <ms>] [--layout <t/s/q>] [--shm <segment>]
+//                         [--listen <host:port>]... [--unix <path>]...
+//
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "generator.h"
+#include "hashids.h"
+#include "server.h"
+
+namespace {
+
+  shortduid::Server* running = nullptr;
+
+  void OnSignal(int) {
+    if(running) running->Stop();
+  }
+
+  int Usage(const char* name) {
+    std::fprintf(stderr, "Usage: %s [--shard <id>] [--salt <salt>] [--epoch <ms>] [--layout <t/s/q>] [--shm <segment>]\n"
+                         "       %*s [--listen <host:port>]... [--unix <path>]...\n", name, (int) std::strlen(name), "");
+    return 1;
+  }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint32_t shard_id = 0;
+  uint64_t epoch_start = 0;
+  std::string salt, segment;
+  shortduid::Generator::Layout layout = shortduid::Generator::LAYOUT_42_10_12;
+  std::vector<std::pair<std::string, uint16_t>> tcp;
+  std::vector<std::string> unix_paths;
+
+  for(int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if(!std::strcmp(argv[i], "--shard") && has_value) {
+      shard_id = (uint32_t) std::strtoul(argv[++i], nullptr, 10);
+    } else if(!std::strcmp(argv[i], "--salt") && has_value) {
+      salt = argv[++i];
+    } else if(!std::strcmp(argv[i], "--epoch") && has_value) {
+      epoch_start = std::strtoull(argv[++i], nullptr, 10);
+    } else if(!std::strcmp(argv[i], "--shm") && has_value) {
+      segment = argv[++i];
+    } else if(!std::strcmp(argv[i], "--layout") && has_value) {
+      unsigned timestamp_bits = 0, shard_bits = 0, sequence_bits = 0;
+      if(std::sscanf(argv[++i], "%u/%u/%u", &timestamp_bits, &shard_bits, &sequence_bits) != 3 || timestamp_bits > 0xff || shard_bits > 0xff || sequence_bits > 0xff) {
+        std::fprintf(stderr, "unknown ID layout %s\n", argv[i]);
+        return 1;
+      }
+      layout = static_cast<shortduid::Generator::Layout>((timestamp_bits << 16) | (shard_bits << 8) | sequence_bits);
+    } else if(!std::strcmp(argv[i], "--listen") && has_value) {
+      std::string address(argv[++i]);
+      size_t colon = address.rfind(':');
+      if(colon == std::string::npos) return Usage(argv[0]);
+      tcp.emplace_back(address.substr(0, colon), (uint16_t) std::strtoul(address.c_str() + colon + 1, nullptr, 10));
+    } else if(!std::strcmp(argv[i], "--unix") && has_value) {
+      unix_paths.push_back(argv[++i]);
+    } else {
+      return Usage(argv[0]);
+    }
+  }
+  if(tcp.empty() && unix_paths.empty()) tcp.emplace_back("127.0.0.1", 6512);
+
+  try {
+    // A segment shares the sequence with every other process on the host, see Generator::Shared
+    std::shared_ptr<shortduid::Generator> generator = segment.empty() ? std::make_shared<shortduid::Generator>(shard_id, epoch_start, layout) : shortduid::Generator::Shared(shard_id, epoch_start, segment, layout);
+    hashidsxx::Hashids hash(salt, 0, DEFAULT_ALPHABET);
+    shortduid::Server server(generator, hash);
+    for(const auto& address : tcp) {
+      uint16_t port = server.ListenTcp(address.first, address.second);
+      std::fprintf(stderr, "listening on %s:%u\n", address.first.c_str(), (unsigned) port);
+    }
+    for(const auto& path : unix_paths) {
+      server.ListenUnix(path);
+      std::fprintf(stderr, "listening on %s\n", path.c_str());
+    }
+
+    running = &server;
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+    server.Run();
+    running = nullptr;
+  } catch(const std::exception& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#ifndef SHORTDUID_SERVER_PROTOCOL_H
+#define SHORTDUID_SERVER_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace shortduid {
+  namespace protocol {
+
+    //
+    // Binary protocol of shortduid_server, all integers little-endian. A client sends any number of requests without
+    // waiting (pipelining), the server answers every one in the order they came in.
+    //
+    // Request, 12 bytes:
+    // | op u8 | version u8 | reserved u16 | tag u32 | count u32 |
+    //
+    // Response, 12 bytes followed by length bytes of payload:
+    // | op u8 | status u8 | reserved u16 | tag u32 | length u32 | payload |
+    //
+    // op and tag are echoed back. OP_INT payload is count IDs of 8 bytes each, OP_HASHID payload is count hashids each
+    // followed by '\n', OP_PING payload is empty. Anything but STATUS_OK comes without payload; after STATUS_BAD_REQUEST
+    // the server closes the connection, as it can not tell where the next request starts.
+    //
+    // A connection starting with "GET " speaks HTTP/1.1 instead, see server/server.h.
+    //
+    const uint8_t VERSION = 1;
+    const size_t HEADER_SIZE = 12;
+    const uint32_t MAX_COUNT = 65536; // IDs per request
+
+    enum Op : uint8_t {
+      OP_PING = 0,
+      OP_INT = 1,
+      OP_HASHID = 2
+    };
+
+    enum Status : uint8_t {
+      STATUS_OK = 0,
+      STATUS_BAD_REQUEST = 1, // Unknown op or version, connection is closed
+      STATUS_TOO_MANY = 2     // count above MAX_COUNT
+    };
+
+    struct Header {
+      uint8_t op;
+      uint8_t version_or_status;
+      uint32_t tag;
+      uint32_t count_or_length;
+    };
+
+    inline void PutU32(unsigned char* p, uint32_t v) {
+      p[0] = (unsigned char) v;
+      p[1] = (unsigned char) (v >> 8);
+      p[2] = (unsigned char) (v >> 16);
+      p[3] = (unsigned char) (v >> 24);
+    }
+
+    inline uint32_t GetU32(const unsigned char* p) {
+      return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    }
+
+    inline void PutU64(unsigned char* p, uint64_t v) {
+      PutU32(p, (uint32_t) v);
+      PutU32(p + 4, (uint32_t) (v >> 32));
+    }
+
+    inline uint64_t GetU64(const unsigned char* p) {
+      return (uint64_t) GetU32(p) | ((uint64_t) GetU32(p + 4) << 32);
+    }
+
+    inline void PutHeader(unsigned char* p, const Header& header) {
+      p[0] = header.op;
+      p[1] = header.version_or_status;
+      p[2] = p[3] = 0;
+      PutU32(p + 4, header.tag);
+      PutU32(p + 8, header.count_or_length);
+    }
+
+    inline Header GetHeader(const unsigned char* p) {
+      Header header;
+      header.op = p[0];
+      header.version_or_status = p[1];
+      header.tag = GetU32(p + 4);
+      header.count_or_length = GetU32(p + 8);
+      return header;
+    }
+
+  }  // namespace protocol
+}  // namespace shortduid
+
+#endif
+// vim: syntax=cpp11:ts=2:sw=2
@@ -0,0 +1,371 @@
+#include "server.h"
+#include "protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace shortduid {
+
+  const size_t Server::READ_CHUNK;
+  const size_t Server::MAX_PENDING_INPUT;
+  const size_t Server::MAX_PENDING_OUTPUT;
+  const size_t Server::MAX_HTTP_HEAD;
+  const uint32_t Server::MAX_HTTP_COUNT;
+
+  namespace {
+
+    std::runtime_error SystemError(const std::string& what, const std::string& name) {
+      return std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+    }
+
+    void SetNonBlocking(int fd) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+#ifdef MSG_NOSIGNAL
+    const int SEND_FLAGS = MSG_NOSIGNAL; // Peer gone is an error to handle, not a SIGPIPE
+#else
+    const int SEND_FLAGS = 0;
+#endif
+
+    bool StartsWith(const unsigned char* data, size_t len, const char* prefix) {
+      size_t prefix_len = std::strlen(prefix);
+      return len >= prefix_len && std::memcmp(data, prefix, prefix_len) == 0;
+    }
+
+    // Case insensitive search of needle in [begin, end)
+    bool Contains(const char* begin, const char* end, const char* needle) {
+      size_t needle_len = std::strlen(needle);
+      for(const char* p = begin; p + needle_len <= end; ++p) {
+        size_t i = 0;
+        while(i < needle_len && std::tolower((unsigned char) p[i]) == needle[i]) ++i;
+        if(i == needle_len) return true;
+      }
+      return false;
+    }
+
+  }  // namespace
+
+  Server::Server(std::shared_ptr<Generator> generator, const hashidsxx::Hashids& hash) : generator_(std::move(generator)), hash_(hash), stop_(false) {
+    if(pipe(wakeup_) != 0) throw SystemError("pipe", "for wakeup");
+    SetNonBlocking(wakeup_[0]);
+    SetNonBlocking(wakeup_[1]);
+  }
+
+  Server::~Server() {
+    for(auto& connection : connections_) close(connection->fd);
+    for(int listener : listeners_) close(listener);
+    for(const auto& path : unix_paths_) unlink(path.c_str());
+    close(wakeup_[0]);
+    close(wakeup_[1]);
+  }
+
+  uint16_t Server::ListenTcp(const std::string& host, uint16_t port) {
+    addrinfo hints, *addresses = nullptr;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    std::string service(std::to_string(port));
+    int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &addresses);
+    if(error != 0) throw std::runtime_error("getaddrinfo " + host + ": " + gai_strerror(error));
+
+    int fd = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+    if(fd < 0) {
+      freeaddrinfo(addresses);
+      throw SystemError("socket", host);
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if(bind(fd, addresses->ai_addr, addresses->ai_addrlen) != 0 || listen(fd, SOMAXCONN) != 0) {
+      auto error = SystemError("bind", host + ":" + service);
+      freeaddrinfo(addresses);
+      close(fd);
+      throw error;
+    }
+    freeaddrinfo(addresses);
+
+    sockaddr_storage bound;
+    socklen_t bound_len = sizeof(bound);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&bound), &bound_len);
+    SetNonBlocking(fd);
+    listeners_.push_back(fd);
+    return ntohs(bound.ss_family == AF_INET6 ? reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port : reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+  }
+
+  void Server::ListenUnix(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(address.sun_path)) throw std::runtime_error("unix socket path too long: " + path);
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) throw SystemError("socket", path);
+    unlink(path.c_str()); // Left behind by a server that did not get to clean up
+    if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+      auto error = SystemError("bind", path);
+      close(fd);
+      throw error;
+    }
+    SetNonBlocking(fd);
+    listeners_.push_back(fd);
+    unix_paths_.push_back(path);
+  }
+
+  void Server::Stop() {
+    stop_ = true;
+    char byte = 0;
+    if(write(wakeup_[1], &byte, 1) < 0) {
+      // Pipe full, a wakeup is pending anyway
+    }
+  }
+
+  void Server::Run() {
+    std::vector<pollfd> fds;
+    while(!stop_) {
+      // Listeners and wakeup first, then every connection in connections_ order
+      fds.clear();
+      fds.push_back({ wakeup_[0], POLLIN, 0 });
+      for(int listener : listeners_) fds.push_back({ listener, POLLIN, 0 });
+      for(auto& connection : connections_) {
+        short events = 0;
+        if(!connection->closing && connection->in.size() - connection->in_pos < MAX_PENDING_INPUT && connection->out.size() - connection->out_pos < MAX_PENDING_OUTPUT) events |= POLLIN;
+        if(connection->out_pos < connection->out.size()) events |= POLLOUT;
+        fds.push_back({ connection->fd, events, 0 });
+      }
+
+      if(poll(fds.data(), fds.size(), -1) < 0) {
+        if(errno == EINTR) continue;
+        throw SystemError("poll", "");
+      }
+
+      if(fds[0].revents) {
+        char buf[64];
+        while(read(wakeup_[0], buf, sizeof(buf)) > 0);
+      }
+
+      size_t first_connection = 1 + listeners_.size();
+      size_t connection_count = connections_.size(); // Accepted below are polled next round
+      for(size_t i = 0; i < connection_count; ++i) {
+        auto& connection = *connections_[i];
+        short revents = fds[first_connection + i].revents;
+        bool alive = true;
+        if(revents & (POLLIN | POLLHUP | POLLERR)) alive = Receive(connection);
+        if(alive) {
+          // Requests held back by the output limit go on as long as the socket takes the answers, the connection is not
+          // polled for input until they are through
+          bool more;
+          do {
+            more = Process(connection);
+            alive = Send(connection);
+          } while(alive && more && connection.out.empty());
+          alive = alive && !(connection.closing && connection.out_pos == connection.out.size());
+        }
+        if(!alive) {
+          close(connection.fd);
+          connections_[i].reset();
+        }
+      }
+      connections_.erase(std::remove(connections_.begin(), connections_.end(), nullptr), connections_.end());
+
+      for(size_t i = 0; i < listeners_.size(); ++i) {
+        if(fds[1 + i].revents & POLLIN) Accept(listeners_[i]);
+      }
+    }
+  }
+
+  void Server::Accept(int listener) {
+    for(;;) {
+      int fd = accept(listener, nullptr, nullptr);
+      if(fd < 0) return; // EAGAIN, or out of descriptors: try again next round
+      SetNonBlocking(fd);
+      int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // Fails harmlessly on Unix sockets
+      std::unique_ptr<Connection> connection(new Connection());
+      connection->fd = fd;
+      connection->mode = Connection::DETECTING;
+      connection->in_pos = 0;
+      connection->out_pos = 0;
+      connection->closing = false;
+      connections_.push_back(std::move(connection));
+    }
+  }
+
+  bool Server::Receive(Connection& connection) {
+    // What the socket has, up to MAX_PENDING_INPUT unprocessed; false once the peer is gone
+    while(connection.in.size() - connection.in_pos < MAX_PENDING_INPUT) {
+      size_t size = connection.in.size();
+      size_t chunk = std::min(READ_CHUNK, MAX_PENDING_INPUT - (size - connection.in_pos));
+      connection.in.resize(size + chunk);
+      ssize_t received = recv(connection.fd, connection.in.data() + size, chunk, 0);
+      connection.in.resize(size + std::max<ssize_t>(received, 0));
+      if(received > 0) {
+        if((size_t) received < chunk) return true;
+        continue;
+      }
+      if(received == 0) return false;
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    return true;
+  }
+
+  bool Server::Send(Connection& connection) {
+    while(connection.out_pos < connection.out.size()) {
+      ssize_t sent = send(connection.fd, connection.out.data() + connection.out_pos, connection.out.size() - connection.out_pos, SEND_FLAGS);
+      if(sent < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+      connection.out_pos += sent;
+    }
+    connection.out.clear();
+    connection.out_pos = 0;
+    return true;
+  }
+
+  bool Server::Process(Connection& connection) {
+    // Whole requests only, a partial one waits for the rest; nothing new while the peer does not read its answers.
+    // True if stopped by that with requests left
+    bool full = false;
+    while(!connection.closing && connection.in_pos < connection.in.size() && connection.out.size() - connection.out_pos < MAX_PENDING_OUTPUT) {
+      const unsigned char* data = connection.in.data() + connection.in_pos;
+      size_t len = connection.in.size() - connection.in_pos;
+      if(connection.mode == Connection::DETECTING) {
+        if(len < 4 && std::memcmp(data, "GET ", len) == 0) break;
+        connection.mode = StartsWith(data, len, "GET ") ? Connection::HTTP : Connection::BINARY;
+      }
+      size_t used = (connection.mode == Connection::HTTP) ? HandleHttp(connection, data, len) : HandleBinary(connection, data, len);
+      if(used == 0) break;
+      connection.in_pos += used;
+      full = connection.out.size() - connection.out_pos >= MAX_PENDING_OUTPUT;
+    }
+
+    if(connection.in_pos == connection.in.size()) {
+      connection.in.clear();
+      connection.in_pos = 0;
+    } else if(connection.in_pos > READ_CHUNK) {
+      connection.in.erase(connection.in.begin(), connection.in.begin() + connection.in_pos);
+      connection.in_pos = 0;
+    }
+    return full && !connection.closing && connection.in_pos < connection.in.size();
+  }
+
+  size_t Server::HandleBinary(Connection& connection, const unsigned char* data, size_t len) {
+    using namespace protocol;
+    if(len < HEADER_SIZE) return 0;
+    Header request = GetHeader(data);
+    Header response = { request.op, STATUS_OK, request.tag, 0 };
+
+    if(request.version_or_status != VERSION || request.op > OP_HASHID) {
+      response.version_or_status = STATUS_BAD_REQUEST;
+      connection.closing = true;
+    } else if(request.count_or_length > MAX_COUNT) {
+      response.version_or_status = STATUS_TOO_MANY;
+    }
+
+    // Header goes in first, length is known once the payload is in place
+    size_t header_at = connection.out.size();
+    connection.out.resize(header_at + HEADER_SIZE);
+    if(response.version_or_status == STATUS_OK && request.op != OP_PING && request.count_or_length > 0) {
+      uint32_t cnt = request.count_or_length;
+      ids_.resize(cnt);
+      generator_->GetUniqueIDs(ids_.data(), cnt);
+      if(request.op == OP_INT) {
+        connection.out.resize(header_at + HEADER_SIZE + cnt * sizeof(uint64_t));
+        unsigned char* out = connection.out.data() + header_at + HEADER_SIZE;
+        for(uint32_t i = 0; i < cnt; ++i) PutU64(out + i * sizeof(uint64_t), ids_[i]);
+      } else {
+        connection.out.resize(header_at + HEADER_SIZE + cnt * (hash_.max_length() + 1));
+        size_t written = hash_.encode_many(ids_.data(), cnt, reinterpret_cast<char*>(connection.out.data() + header_at + HEADER_SIZE), nullptr, '\n');
+        connection.out.resize(header_at + HEADER_SIZE + written);
+      }
+    }
+    response.count_or_length = (uint32_t) (connection.out.size() - header_at - HEADER_SIZE);
+    PutHeader(connection.out.data() + header_at, response);
+    return HEADER_SIZE;
+  }
+
+  size_t Server::HandleHttp(Connection& connection, const unsigned char* data, size_t len) {
+    const char* begin = reinterpret_cast<const char*>(data);
+    const char* head_end = nullptr;
+    for(size_t i = 3; i < len; ++i) {
+      if(begin[i] == '\n' && begin[i - 1] == '\r' && begin[i - 2] == '\n' && begin[i - 3] == '\r') {
+        head_end = begin + i + 1;
+        break;
+      }
+    }
+    if(!head_end) {
+      if(len > MAX_HTTP_HEAD) HttpResponse(connection, 431, "Request Header Fields Too Large", "{\"error\":\"request too large\"}", false);
+      return len > MAX_HTTP_HEAD ? len : 0;
+    }
+
+    // GET <target> HTTP/1.x, bodies are not expected and not supported
+    const char* line_end = static_cast<const char*>(std::memchr(begin, '\r', head_end - begin));
+    // Pipelined requests after the first one of an HTTP connection may be anything, the line must hold "GET " first
+    const char* target = begin + 4;
+    bool get = StartsWith(reinterpret_cast<const unsigned char*>(begin), line_end - begin, "GET ");
+    const char* target_end = get ? static_cast<const char*>(std::memchr(target, ' ', line_end - target)) : nullptr;
+    if(!target_end) {
+      HttpResponse(connection, 400, "Bad Request", "{\"error\":\"bad request\"}", false);
+      return head_end - begin;
+    }
+    bool keep_alive = Contains(target_end, line_end, "http/1.1") ? !Contains(line_end, head_end, "connection: close") : Contains(line_end, head_end, "connection: keep-alive");
+    std::string path(target, target_end);
+    size_t query = path.find('?');
+    if(query != std::string::npos) path.resize(query);
+
+    bool hashids = path.compare(0, 5, "/duid") == 0;
+    bool numeric = path.compare(0, 6, "/nduid") == 0;
+    size_t route_len = hashids ? 5 : 6;
+    if(path == "/") {
+      HttpResponse(connection, 200, "OK", "{\"name\":\"ShortDUID API\"}", keep_alive);
+    } else if((hashids || numeric) && (path.size() == route_len || path[route_len] == '/')) {
+      // Same count rules as getDUID and getDUIDInt
+      uint32_t cnt = 1;
+      if(path.size() > route_len + 1) {
+        cnt = (uint32_t) std::min<int64_t>(std::llabs(std::strtoll(path.c_str() + route_len + 1, nullptr, 10)), UINT32_MAX);
+        cnt = (cnt > MAX_HTTP_COUNT) ? 1 : cnt; // Check boundaries
+      }
+      ids_.resize(cnt);
+      generator_->GetUniqueIDs(ids_.data(), cnt);
+      std::string body("[");
+      std::vector<char> hash_buf(hash_.max_length());
+      for(uint32_t i = 0; i < cnt; ++i) {
+        if(i > 0) body += ',';
+        body += '"';
+        if(hashids) {
+          body.append(hash_buf.data(), hash_.encode_one(ids_[i], hash_buf.data()));
+        } else {
+          body += std::to_string(ids_[i]);
+        }
+        body += '"';
+      }
+      body += ']';
+      HttpResponse(connection, 200, "OK", body, keep_alive);
+    } else {
+      HttpResponse(connection, 404, "Not Found", "{\"error\":\"not found\"}", keep_alive);
+    }
+    return head_end - begin;
+  }
+
+  void Server::HttpResponse(Connection& connection, int status, const char* reason, const std::string& body, bool keep_alive) {
+    std::string head("HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\nContent-Type: application/json\r\nContent-Length: " +
+                     std::to_string(body.size()) + (keep_alive ? "\r\n\r\n" : "\r\nConnection: close\r\n\r\n"));
+    connection.out.insert(connection.out.end(), head.begin(), head.end());
+    connection.out.insert(connection.out.end(), body.begin(), body.end());
+    if(!keep_alive) connection.closing = true;
+  }
+
+}  // namespace shortduid
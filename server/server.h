@@ -0,0 +1,88 @@
+// vim: syntax=cpp11:ts=2:sw=2
+#ifndef SHORTDUID_SERVER_H
+#define SHORTDUID_SERVER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "generator.h"
+#include "hashids.h"
+
+namespace shortduid {
+
+  //
+  // ID server on TCP and Unix sockets: single threaded poll() loop speaking the pipelined binary protocol of
+  // server/protocol.h, or on connections starting with "GET " minimal HTTP/1.1 keep-alive with the routes of
+  // examples/API_Server:
+  //   GET /duid/<count>   JSON array of hashids
+  //   GET /nduid/<count>  JSON array of numeric IDs as strings
+  // count defaults to 1 and, as in getDUID, anything above 8192 reads as 1.
+  //
+  // IDs come from generator, which other threads or processes may use at the same time. POSIX only, throws
+  // std::runtime_error if a socket can not be set up.
+  //
+  class Server {
+  public:
+    Server(std::shared_ptr<Generator> generator, const hashidsxx::Hashids& hash);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    //
+    // Listen on host:port, port 0 picks a free one; returns the port
+    //
+    uint16_t ListenTcp(const std::string& host, uint16_t port);
+    //
+    // Listen on a Unix socket at path, replacing a stale one; removed again on destruction
+    //
+    void ListenUnix(const std::string& path);
+
+    //
+    // Serve until Stop(), which may be called from any thread or a signal handler
+    //
+    void Run();
+    void Stop();
+
+  private:
+    static const size_t READ_CHUNK = 64 * 1024;
+    static const size_t MAX_PENDING_INPUT = 4 * 1024 * 1024;  // Stop reading a connection until its requests are answered
+    static const size_t MAX_PENDING_OUTPUT = 4 * 1024 * 1024; // Stop answering a connection that does not read its answers
+    static const size_t MAX_HTTP_HEAD = 8 * 1024;
+    static const uint32_t MAX_HTTP_COUNT = 8192;
+
+    struct Connection {
+      int fd;
+      enum { DETECTING, BINARY, HTTP } mode;
+      std::vector<unsigned char> in;
+      size_t in_pos;
+      std::vector<unsigned char> out;
+      size_t out_pos;
+      bool closing; // Close once out is written
+    };
+
+    void Accept(int listener);
+    bool Receive(Connection& connection);
+    bool Send(Connection& connection);
+    bool Process(Connection& connection);
+    size_t HandleBinary(Connection& connection, const unsigned char* data, size_t len);
+    size_t HandleHttp(Connection& connection, const unsigned char* data, size_t len);
+    void HttpResponse(Connection& connection, int status, const char* reason, const std::string& body, bool keep_alive);
+
+    std::shared_ptr<Generator> generator_;
+    const hashidsxx::Hashids& hash_;
+    std::vector<int> listeners_;
+    std::vector<std::string> unix_paths_;
+    std::vector<std::unique_ptr<Connection>> connections_;
+    std::vector<uint64_t> ids_; // Scratch
+    int wakeup_[2];             // Self-pipe, Stop() writes to it
+    std::atomic<bool> stop_;
+  };
+
+}  // namespace shortduid
+
+#endif
+// vim: syntax=cpp11:ts=2:sw=2
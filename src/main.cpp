@@ -1,16 +1,16 @@
-#include <node.h>
+#include <node_api.h>
 #include "shortduid.h"
 
 namespace shortduid {
 
-  using v8::Local;
-  using v8::Object;
-
-  void InitAll(Local<Object> exports) {
-    ShortDUID::Init(exports);
+  napi_value InitAll(napi_env env, napi_value exports) {
+    return ShortDUID::Init(env, exports);
   }
 
-  NODE_MODULE(addon, InitAll)
-
 }  // namespace shortduid
+
+// Context aware: loaded once per environment, main thread and every worker_thread
+NAPI_MODULE_INIT() {
+  return shortduid::InitAll(env, exports);
+}
 // vim: syntax=cpp11:ts=2:sw=2
@@ -2,290 +2,1167 @@
 
 namespace shortduid {
 
-  using v8::Function;
-  using v8::FunctionCallbackInfo;
-  using v8::FunctionTemplate;
-  using v8::HandleScope;
-  using v8::Isolate;
-  using v8::Local;
-  using v8::Number;
-  using v8::Object;
-  using v8::Persistent;
-  using v8::String;
-  using v8::Value;
+  namespace {
+
+    //
+    // Per environment state, lives as long as the main thread or worker it was loaded into
+    //
+    struct AddonData {
+      napi_ref constructor;
+    };
+
+    void DeleteAddonData(napi_env env, void* data, void* /*hint*/) {
+      auto addon_data = static_cast<AddonData*>(data);
+      napi_delete_reference(env, addon_data->constructor);
+      delete addon_data;
+    }
+
+    //
+    // Argument conversion, same coercion rules as the V8 calls the add-on used before
+    //
+    bool IsUndefined(napi_env env, napi_value value) {
+      napi_valuetype type = napi_undefined;
+      napi_typeof(env, value, &type);
+      return type == napi_undefined;
+    }
+
+    // Numbers, the common case, are read directly; anything else takes the coercion round trip
+    int64_t ToInteger(napi_env env, napi_value value) {
+      napi_value number;
+      int64_t ret = 0;
+      if (napi_get_value_int64(env, value, &ret) == napi_ok) return ret;
+      if (napi_coerce_to_number(env, value, &number) == napi_ok) napi_get_value_int64(env, number, &ret);
+      return ret;
+    }
+
+    // As above, fallback for undefined, so an omitted argument costs no extra typeof call when one is given
+    int64_t ToInteger(napi_env env, napi_value value, int64_t fallback) {
+      int64_t ret = 0;
+      if (napi_get_value_int64(env, value, &ret) == napi_ok) return ret;
+      return IsUndefined(env, value) ? fallback : ToInteger(env, value);
+    }
+
+    uint32_t ToUint32(napi_env env, napi_value value) {
+      napi_value number;
+      uint32_t ret = 0;
+      if (napi_get_value_uint32(env, value, &ret) == napi_ok) return ret;
+      if (napi_coerce_to_number(env, value, &number) == napi_ok) napi_get_value_uint32(env, number, &ret);
+      return ret;
+    }
+
+    uint32_t ToUint32(napi_env env, napi_value value, uint32_t fallback) {
+      uint32_t ret = 0;
+      if (napi_get_value_uint32(env, value, &ret) == napi_ok) return ret;
+      return IsUndefined(env, value) ? fallback : ToUint32(env, value);
+    }
+
+    bool ToBoolean(napi_env env, napi_value value) {
+      napi_value boolean;
+      bool ret = false;
+      if (napi_coerce_to_bool(env, value, &boolean) == napi_ok) napi_get_value_bool(env, boolean, &ret);
+      return ret;
+    }
+
+    std::string ToString(napi_env env, napi_value value) {
+      napi_value str;
+      size_t len = 0;
+      if (napi_coerce_to_string(env, value, &str) != napi_ok) return std::string();
+      napi_get_value_string_utf8(env, str, nullptr, 0, &len);
+      std::string ret(len, '\0');
+      napi_get_value_string_utf8(env, str, &ret[0], len + 1, &len); // Terminating null goes into std::string's own
+      return ret;
+    }
+
+    // True for a typed array of the wanted type, data already points at its byte offset (null if empty)
+    bool GetTypedArray(napi_env env, napi_value value, napi_typedarray_type wanted, void** data, size_t* length) {
+      bool is_typedarray = false;
+      napi_is_typedarray(env, value, &is_typedarray);
+      if (!is_typedarray) return false;
+
+      napi_typedarray_type type;
+      napi_value arraybuffer;
+      size_t byte_offset;
+      napi_get_typedarray_info(env, value, &type, length, data, &arraybuffer, &byte_offset);
+      return type == wanted;
+    }
+
+    // First character of a string argument as a delimiter, -1 for none
+    int ToDelimiter(napi_env env, napi_value value) {
+      napi_valuetype type = napi_undefined;
+      napi_typeof(env, value, &type);
+      if (type != napi_string) return -1;
+      std::string delimiter(ToString(env, value));
+      return delimiter.empty() ? -1 : static_cast<uint8_t>(delimiter[0]);
+    }
+
+    //
+    // Result creation
+    //
+    napi_value NewString(napi_env env, const char* str, size_t len) {
+      napi_value ret = nullptr;
+      napi_create_string_utf8(env, str, len, &ret);
+      return ret;
+    }
+
+    napi_value NewString(napi_env env, const std::string& str) {
+      return NewString(env, str.data(), str.size());
+    }
+
+    // Hashids, decimal IDs and random keys are ASCII: one-byte strings copied as they are, no UTF-8 decoding
+    napi_value NewAsciiString(napi_env env, const char* str, size_t len) {
+      napi_value ret = nullptr;
+      napi_create_string_latin1(env, str, len, &ret);
+      return ret;
+    }
+
+    // Decimal form of number into output, which must hold 20 characters; returns the length. Replaces std::to_string
+    // temporaries
+    const size_t MAX_DECIMAL_LENGTH = 20;
+    const uint64_t MAX_API_KEYS_BYTES = 16 << 20; // Of one getRandomAPIKeys() call, counting one more byte per key
+
+    size_t FormatDecimal(uint64_t number, char* output) {
+      char buf[MAX_DECIMAL_LENGTH];
+      char* p = buf + sizeof(buf);
+      do {
+        *--p = static_cast<char>('0' + number % 10);
+        number /= 10;
+      } while (number);
+      size_t len = buf + sizeof(buf) - p;
+      std::memcpy(output, p, len);
+      return len;
+    }
+
+    napi_value NewDecimalString(napi_env env, uint64_t number) {
+      char buf[MAX_DECIMAL_LENGTH];
+      return NewAsciiString(env, buf, FormatDecimal(number, buf));
+    }
+
+    //
+    // Array of cnt one-byte strings, element(i, len) returns where the characters of the i-th are and sets their length
+    //
+    template<class F> napi_value NewStringArray(napi_env env, size_t cnt, F element) {
+      napi_value ret = nullptr;
+      napi_create_array_with_length(env, cnt, &ret);
+      for(size_t i = 0; i < cnt; ++i) {
+        size_t len = 0;
+        const char* str = element(i, len);
+        napi_set_element(env, ret, static_cast<uint32_t>(i), NewAsciiString(env, str, len));
+      }
+      return ret;
+    }
+
+    // Numbers in decimal, as an array of strings
+    napi_value NewDecimalArray(napi_env env, const uint64_t* numbers, size_t cnt) {
+      char buf[MAX_DECIMAL_LENGTH];
+      return NewStringArray(env, cnt, [&](size_t i, size_t& len) {
+        len = FormatDecimal(numbers[i], buf);
+        return buf;
+      });
+    }
 
-  Persistent<Function> ShortDUID::constructor;
+    napi_value NewNumber(napi_env env, double number) {
+      napi_value ret = nullptr;
+      napi_create_double(env, number, &ret);
+      return ret;
+    }
 
-  ShortDUID::ShortDUID(const uint32_t shard_id, const std::string salt, const uint64_t epoch_start) : salt_(salt), epoch_start_(epoch_start), shard_id_(shard_id), hash(salt, 0, DEFAULT_ALPHABET) {
-    time_offset_ = 0; // Mainly used in tests, applied to the time before ID is generated
-    sequence_ = 0ULL; // Sub-millisecond sequence
+    napi_value NewBigInt(napi_env env, uint64_t number) {
+      napi_value ret = nullptr;
+      napi_create_bigint_uint64(env, number, &ret);
+      return ret;
+    }
 
-    //Setup time related variables
-    auto mono_time = (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
-    system_time_at_start_ = (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-    // In case steady clock do not show same time as system clock
-    mono_epoch_diff_ = system_time_at_start_ - mono_time;
+    // Bound of minIdForTime/maxIdForTime as BigInt, or as sortable key with format 'sortable'. Not permuted: IDs of a
+    // millisecond only permute among themselves, so their keys stay within the bounds of the millisecond
+    napi_value NewIdBound(napi_env env, const SortableCodec& sortable, uint64_t bound, napi_value format) {
+      if (!IsUndefined(env, format) && ToString(env, format) == "sortable") {
+        char key[SortableCodec::WIDTH];
+        sortable.EncodeValue(bound, key);
+        return NewAsciiString(env, key, sizeof(key));
+      }
+      return NewBigInt(env, bound);
+    }
 
-    std::fill(std::begin(ts_seq_), std::end(ts_seq_), 0ULL); //This is used to track overflow of sequence per unit of time
-    //Check to see if custom epoch does not overflow current time and reset it to 0 if it does
-    if(epoch_start_ > system_time_at_start_) {
-      epoch_start_ = 0ULL;
+    // ID given as BigInt, number or decimal string, like getDUIDBigInt and getDUIDInt hand them out
+    uint64_t ToID(napi_env env, napi_value value) {
+      uint64_t ret = 0;
+      bool lossless;
+      if (napi_get_value_bigint_uint64(env, value, &ret, &lossless) == napi_ok) return ret;
+      int64_t number = 0;
+      if (napi_get_value_int64(env, value, &number) == napi_ok) return number;
+      return std::strtoull(ToString(env, value).c_str(), NULL, 10);
     }
+
+    // Milliseconds since unix epoch as number, BigInt or Date; clamped to what fits, negative ones to 0
+    uint64_t ToTime(napi_env env, napi_value value) {
+      uint64_t ret = 0;
+      bool lossless;
+      if (napi_get_value_bigint_uint64(env, value, &ret, &lossless) == napi_ok) {
+        if (lossless) return ret;
+        int sign_bit = 0;
+        size_t word_count = 1;
+        uint64_t word;
+        napi_get_value_bigint_words(env, value, &sign_bit, &word_count, &word);
+        return sign_bit ? 0 : UINT64_MAX;
+      }
+      int64_t time = ToInteger(env, value);
+      return (time < 0) ? 0 : time;
+    }
+
+    void FreeBuffer(napi_env /*env*/, void* data, void* /*hint*/) {
+      std::free(data);
+    }
+
+    //
+    // Batch generated on a libuv worker thread. Holds its own generator reference and hashid codec, the instance may
+    // be collected before the batch completes
+    //
+    struct AsyncBatch {
+      napi_async_work work;
+      napi_deferred deferred;
+      std::shared_ptr<Generator> generator;
+      std::unique_ptr<hashidsxx::Hashids> hash; // Null for integer batches
+      std::shared_ptr<std::atomic<uint64_t>> floor; // Of the instance's prefetch ring, null without one
+      size_t cnt;
+      char* data;
+      size_t len;
+    };
+
+    // Rejects a batch that never made it onto the thread pool, frees it and hands its promise back
+    napi_value RejectBatch(napi_env env, AsyncBatch* batch, napi_value promise, const char* message) {
+      napi_value error;
+      napi_create_error(env, nullptr, NewString(env, message), &error);
+      napi_reject_deferred(env, batch->deferred, error);
+      std::free(batch->data);
+      batch->data = nullptr;
+      return promise;
+    }
+
+    const size_t ASYNC_CHUNK = 4096; // IDs claimed at once, one millisecond worth, so synchronous callers interleave
+
+    void ExecuteBatch(napi_env /*env*/, void* data) {
+      // Worker thread, no N-API calls here
+      auto batch = static_cast<AsyncBatch*>(data);
+      size_t size = batch->hash ? batch->cnt * (batch->hash->max_length() + 1) : batch->cnt * sizeof(uint64_t);
+      batch->data = static_cast<char*>(std::malloc(std::max<size_t>(size, 1))); // malloc is aligned for uint64_t
+      if (!batch->data) return;
+
+      uint64_t ids[ASYNC_CHUNK];
+      for(size_t i = 0; i < batch->cnt; i += ASYNC_CHUNK) {
+        size_t chunk = std::min(batch->cnt - i, ASYNC_CHUNK);
+        if (batch->hash) {
+          batch->generator->GetUniqueIDs(ids, chunk);
+          batch->len += batch->hash->encode_many(ids, chunk, batch->data + batch->len, nullptr, '\n');
+        } else {
+          batch->generator->GetUniqueIDs(reinterpret_cast<uint64_t*>(batch->data) + i, chunk);
+          batch->len += chunk * sizeof(uint64_t);
+        }
+        if (batch->floor) Prefetcher::Advance(*batch->floor, batch->hash ? ids[chunk - 1] : reinterpret_cast<uint64_t*>(batch->data)[i + chunk - 1]);
+      }
+    }
+
+    void CompleteBatch(napi_env env, napi_status status, void* data) {
+      // Back on the JS thread: hand the memory over to a Buffer or BigUint64Array and settle the promise
+      std::unique_ptr<AsyncBatch> batch(static_cast<AsyncBatch*>(data));
+      napi_value result = nullptr;
+      if (status == napi_ok && batch->data) {
+        if (batch->hash) {
+          char* shrunk = static_cast<char*>(std::realloc(batch->data, std::max<size_t>(batch->len, 1)));
+          batch->data = shrunk ? shrunk : batch->data;
+          if (napi_create_external_buffer(env, batch->len, batch->data, FreeBuffer, nullptr, &result) != napi_ok) result = nullptr;
+        } else {
+          napi_value arraybuffer;
+          if (napi_create_external_arraybuffer(env, batch->data, batch->len, FreeBuffer, nullptr, &arraybuffer) != napi_ok ||
+              napi_create_typedarray(env, napi_biguint64_array, batch->cnt, arraybuffer, 0, &result) != napi_ok) result = nullptr;
+        }
+        if (!result) std::free(batch->data);
+      }
+
+      if (result) {
+        napi_resolve_deferred(env, batch->deferred, result);
+      } else {
+        napi_value error;
+        napi_create_error(env, nullptr, NewString(env, std::string(status == napi_cancelled ? "cancelled" : "out of memory")), &error);
+        napi_reject_deferred(env, batch->deferred, error);
+      }
+      napi_delete_async_work(env, batch->work);
+    }
+
+  }  // namespace
+
+  ShortDUID::ShortDUID(const uint32_t shard_id, const std::string salt, const uint64_t epoch_start, const bool shared, const std::string segment, const Generator::Layout layout, const unsigned int min_length, const std::string alphabet) : salt_(salt), generator((shared || !segment.empty()) ? Generator::Shared(shard_id, epoch_start, segment, layout) : std::make_shared<Generator>(shard_id, epoch_start, layout)), hash(salt, min_length, alphabet) {
   }
 
   ShortDUID::~ShortDUID() {
   }
 
-  void ShortDUID::Init(Local<Object> exports) {
-    auto isolate = Isolate::GetCurrent();
+  void ShortDUID::GenerateIDs(uint64_t* ids, size_t cnt) {
+    generator->GetUniqueIDs(ids, cnt);
+    if (prefetch && cnt > 0) prefetch->Advance(ids[cnt - 1]);
+  }
 
-    // Prepare constructor template
-    Local<FunctionTemplate> tpl = FunctionTemplate::New(isolate, New);
-    tpl->SetClassName(String::NewFromUtf8(isolate, "ShortDUID"));
-    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+  uint64_t ShortDUID::GenerateID() {
+    uint64_t id;
+    GenerateIDs(&id, 1);
+    return id;
+  }
 
+  napi_value ShortDUID::Init(napi_env env, napi_value exports) {
     // Prototype
-    NODE_SET_PROTOTYPE_METHOD(tpl, "getDUID", GetDUID);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "getDUIDInt", GetDUIDInt);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "getShardID", GetShardID);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "getEpochStart", GetEpochStart);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "getSalt", GetSalt);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "hashidEncode", HashidEncode);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "hashidDecode", HashidDecode);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "getRandomAPIKey", GetRandomAPIKey);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "getRandomPassword", GetRandomPassword);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "driftTime", DriftTime);
-    NODE_SET_PROTOTYPE_METHOD(tpl, "getCurrentTimeMs", GetCurrentTimeMs);
-
-    constructor.Reset(isolate, tpl->GetFunction());
-    exports->Set(String::NewFromUtf8(isolate, "ShortDUID"), tpl->GetFunction());
-  }
-
-  void ShortDUID::New(const FunctionCallbackInfo<Value>& args) {
-    auto isolate = args.GetIsolate();
-
-    if (args.IsConstructCall()) {
+    napi_property_descriptor properties[] = {
+      { "getDUID", nullptr, GetDUID, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getDUIDInt", nullptr, GetDUIDInt, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "fillDUIDInt", nullptr, FillDUIDInt, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getDUIDBigInt", nullptr, GetDUIDBigInt, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getDUIDAsync", nullptr, GetDUIDAsync, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getDUIDIntAsync", nullptr, GetDUIDIntAsync, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getShardID", nullptr, GetShardID, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getEpochStart", nullptr, GetEpochStart, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getSalt", nullptr, GetSalt, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "parseDUID", nullptr, ParseDUID, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "parseMany", nullptr, ParseMany, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "minIdForTime", nullptr, MinIdForTime, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "maxIdForTime", nullptr, MaxIdForTime, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getStats", nullptr, GetStats, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "resetStats", nullptr, ResetStats, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getDriftMs", nullptr, GetDriftMs, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getSequenceBudget", nullptr, GetSequenceBudget, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "hashidEncode", nullptr, HashidEncode, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "hashidDecode", nullptr, HashidDecode, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "encodeMany", nullptr, EncodeMany, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "decodeMany", nullptr, DecodeMany, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getSortableID", nullptr, GetSortableID, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "encodeSortable", nullptr, EncodeSortable, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "decodeSortable", nullptr, DecodeSortable, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getRandomAPIKey", nullptr, GetRandomAPIKey, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getRandomPassword", nullptr, GetRandomPassword, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getRandomAPIKeys", nullptr, GetRandomAPIKeys, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "driftTime", nullptr, DriftTime, nullptr, nullptr, nullptr, napi_default, nullptr },
+      { "getCurrentTimeMs", nullptr, GetCurrentTimeMs, nullptr, nullptr, nullptr, napi_default, nullptr },
+    };
+
+    napi_value cons;
+    if (napi_define_class(env, "ShortDUID", NAPI_AUTO_LENGTH, New, nullptr, sizeof(properties) / sizeof(properties[0]), properties, &cons) != napi_ok) return nullptr;
+
+    // Constructor is kept per environment, so plain function calls of ShortDUID(...) work in every worker
+    auto addon_data = new AddonData();
+    napi_create_reference(env, cons, 1, &addon_data->constructor);
+    napi_set_instance_data(env, addon_data, DeleteAddonData, nullptr);
+
+    napi_set_named_property(env, exports, "ShortDUID", cons);
+    return exports;
+  }
+
+  napi_value ShortDUID::New(napi_env env, napi_callback_info info) {
+    size_t argc = 4;
+    napi_value args[4];
+    napi_value self;
+    napi_get_cb_info(env, info, &argc, args, &self, nullptr);
+    for(size_t i = argc; i < 4; ++i) napi_get_undefined(env, &args[i]);
+
+    napi_value new_target = nullptr;
+    napi_get_new_target(env, info, &new_target);
+
+    if (new_target) {
       std::string salt("");
       // Invoked as constructor: `new ShortDUID(...)`
-      // Ensure that shard_id is no larger than 10 bits integer
-      uint32_t shard_id    = std::abs(args[0]->IsUndefined() ? 0 : args[0]->IntegerValue()) & ((1UL << 10) - 1);
+      // Ensure that shard_id fits the shard bits of the layout
+      uint32_t shard_id    = std::abs(IsUndefined(env, args[0]) ? 0 : ToInteger(env, args[0])); // Generator masks it to its shard bits
       uint64_t epoch_start = 0;
 
-      if(!args[2]->IsUndefined()) {
-        String::Utf8Value _s_int64(args[2]->ToString());
-        epoch_start = std::strtoll(*_s_int64, NULL, 10);
+      if(!IsUndefined(env, args[2])) {
+        epoch_start = ToID(env, args[2]); // Number, BigInt or decimal string
       }
 
-      if(!args[1]->IsUndefined()) {
-        String::Utf8Value _salt(args[1]->ToString());
-        salt = *_salt;
+      if(!IsUndefined(env, args[1])) {
+        salt = ToString(env, args[1]);
+      }
+
+      // { layout: 'timestamp/shard/sequence' bits }, one of Generator::Layout; anything else throws once constructed
+      Generator::Layout layout = Generator::LAYOUT_42_10_12;
+      napi_valuetype options_type = napi_undefined;
+      napi_typeof(env, args[3], &options_type);
+      if(options_type == napi_object) {
+        napi_value value;
+        if(napi_get_named_property(env, args[3], "layout", &value) == napi_ok && !IsUndefined(env, value)) {
+          unsigned timestamp_bits = 0, shard_bits = 0, sequence_bits = 0;
+          std::string layout_str(ToString(env, value));
+          if(std::sscanf(layout_str.c_str(), "%u/%u/%u", &timestamp_bits, &shard_bits, &sequence_bits) != 3 || timestamp_bits > 0xff || shard_bits > 0xff || sequence_bits > 0xff) {
+            napi_throw_error(env, nullptr, ("unknown ID layout " + layout_str).c_str());
+            return nullptr;
+          }
+          layout = static_cast<Generator::Layout>((timestamp_bits << 16) | (shard_bits << 8) | sequence_bits);
+        }
       }
 
-      ShortDUID* obj = new ShortDUID(shard_id, salt, epoch_start);
-      obj->Wrap(args.This());
-      args.GetReturnValue().Set(args.This());
+      // { minLength, alphabet } of the hashids, e.g. fixed length slugs. Hashids would quietly fall back to its default
+      // alphabet
+      unsigned int min_length = 0;
+      std::string alphabet(DEFAULT_ALPHABET);
+      if(options_type == napi_object) {
+        napi_value value;
+        if(napi_get_named_property(env, args[3], "minLength", &value) == napi_ok && !IsUndefined(env, value)) {
+          int64_t length = ToInteger(env, value);
+          if(length < 0 || length > 1024) { // hashidDecode takes up to 1024 characters
+            napi_throw_range_error(env, nullptr, "minLength must be 0 to 1024");
+            return nullptr;
+          }
+          min_length = length;
+        }
+        if(napi_get_named_property(env, args[3], "alphabet", &value) == napi_ok && !IsUndefined(env, value)) {
+          alphabet = ToString(env, value);
+          if(!hashidsxx::Hashids::valid_alphabet(alphabet)) {
+            napi_throw_error(env, nullptr, "alphabet must be at least 16 unique printable ASCII characters, no spaces");
+            return nullptr;
+          }
+        }
+      }
+
+      // { sortable: 'base62' | 'base64url', sortableKey } of getSortableID and friends, see core/sortable.h
+      SortableCodec::Alphabet sortable = SortableCodec::BASE62;
+      std::string sortable_key("");
+      if(options_type == napi_object) {
+        napi_value value;
+        if(napi_get_named_property(env, args[3], "sortable", &value) == napi_ok && !IsUndefined(env, value)) {
+          std::string sortable_str(ToString(env, value));
+          if(sortable_str != "base62" && sortable_str != "base64url") {
+            napi_throw_error(env, nullptr, ("unknown sortable alphabet " + sortable_str).c_str());
+            return nullptr;
+          }
+          sortable = (sortable_str == "base64url") ? SortableCodec::BASE64URL : SortableCodec::BASE62;
+        }
+        if(napi_get_named_property(env, args[3], "sortableKey", &value) == napi_ok && !IsUndefined(env, value)) sortable_key = ToString(env, value);
+      }
+
+      // Options, { shared: true } hands out IDs from the process wide generator of this shard, { shm: name } from the one
+      // of every process on the host opening that segment, see Generator::Shared
+      bool shared = false;
+      std::string segment("");
+      if(options_type == napi_object) {
+        napi_value value;
+        if(napi_get_named_property(env, args[3], "shared", &value) == napi_ok) shared = ToBoolean(env, value);
+        napi_valuetype shm_type = napi_undefined;
+        if(napi_get_named_property(env, args[3], "shm", &value) == napi_ok && napi_typeof(env, value, &shm_type) == napi_ok) {
+          if(shm_type == napi_string) {
+            segment = ToString(env, value);
+          } else if(shm_type != napi_undefined && ToBoolean(env, value)) {
+            segment = "/shortduid-" + std::to_string(shard_id & ((1UL << ShardBits(layout)) - 1)) + "-" + std::to_string(epoch_start);
+          }
+        }
+      }
+
+      // { highWaterMark: path, highWaterLeaseMs: ms } resumes above everything handed out before a restart
+      std::string high_water_mark("");
+      uint64_t high_water_lease_ms = 10000;
+      if(options_type == napi_object) {
+        napi_value value;
+        if(napi_get_named_property(env, args[3], "highWaterMark", &value) == napi_ok && !IsUndefined(env, value)) high_water_mark = ToString(env, value);
+        if(napi_get_named_property(env, args[3], "highWaterLeaseMs", &value) == napi_ok && !IsUndefined(env, value)) high_water_lease_ms = std::abs(ToInteger(env, value));
+      }
+
+      // { timeSource: 'steady' | 'coarse' | 'ticker' }, see Generator::TimeSource
+      std::string time_source("");
+      if(options_type == napi_object) {
+        napi_value value;
+        if(napi_get_named_property(env, args[3], "timeSource", &value) == napi_ok && !IsUndefined(env, value)) time_source = ToString(env, value);
+      }
+
+      // { prefetch: true | { depth, lowWatermark, maxAgeMs } } serves getDUID from a ring filled ahead of time, see
+      // core/prefetch.h
+      bool prefetch = false;
+      size_t prefetch_depth = 4096;
+      size_t prefetch_low_watermark = 1024;
+      uint64_t prefetch_max_age_ms = 1000;
+      if(options_type == napi_object) {
+        napi_value value;
+        napi_valuetype prefetch_type = napi_undefined;
+        if(napi_get_named_property(env, args[3], "prefetch", &value) == napi_ok && napi_typeof(env, value, &prefetch_type) == napi_ok) {
+          prefetch = (prefetch_type == napi_object) || ToBoolean(env, value);
+          if(prefetch_type == napi_object) {
+            napi_value setting;
+            if(napi_get_named_property(env, value, "depth", &setting) == napi_ok && !IsUndefined(env, setting)) prefetch_depth = std::abs(ToInteger(env, setting));
+            if(napi_get_named_property(env, value, "lowWatermark", &setting) == napi_ok && !IsUndefined(env, setting)) prefetch_low_watermark = std::abs(ToInteger(env, setting));
+            if(napi_get_named_property(env, value, "maxAgeMs", &setting) == napi_ok && !IsUndefined(env, setting)) prefetch_max_age_ms = std::abs(ToInteger(env, setting));
+          }
+          prefetch_depth = (prefetch_depth > 65536) ? 65536 : prefetch_depth; // Check boundaries
+        }
+      }
+
+      ShortDUID* obj = nullptr;
+      try {
+        obj = new ShortDUID(shard_id, salt, epoch_start, shared, segment, layout, min_length, alphabet);
+        obj->sortable = SortableCodec(sortable, sortable_key, ShardBits(layout) + SequenceBits(layout));
+        if(!high_water_mark.empty()) obj->generator->EnableHighWaterMark(high_water_mark, high_water_lease_ms);
+        if(time_source == "coarse") obj->generator->SetTimeSource(Generator::COARSE_CLOCK);
+        if(time_source == "ticker") obj->generator->SetTimeSource(Generator::TICKER_CLOCK);
+        if(prefetch) obj->prefetch.reset(new Prefetcher(obj->generator, obj->hash, prefetch_depth, prefetch_low_watermark, prefetch_max_age_ms));
+      } catch(const std::exception& e) {
+        delete obj;
+        // Silently falling back to a private generator would hand out duplicates
+        napi_throw_error(env, nullptr, e.what());
+        return nullptr;
+      }
+      // Finalizer runs on garbage collection or, at the latest, when the environment is torn down
+      if (napi_wrap(env, self, obj, Destructor, nullptr, nullptr) != napi_ok) {
+        delete obj;
+        return nullptr;
+      }
+      return self;
     } else {
       // Invoked as plain function `ShortDUID(...)`, turn into construct call.
-      const int argc = 3;
-      Local<Value> argv[] = { args[0], args[1], args[2] };
-      Local<Function> cons = Local<Function>::New(isolate, constructor);
-      args.GetReturnValue().Set(cons->NewInstance(argc, argv));
+      AddonData* addon_data = nullptr;
+      napi_value cons;
+      napi_value instance = nullptr;
+      napi_get_instance_data(env, reinterpret_cast<void**>(&addon_data));
+      napi_get_reference_value(env, addon_data->constructor, &cons);
+      napi_new_instance(env, cons, 4, args, &instance);
+      return instance;
     }
   }
 
-  void ShortDUID::DriftTime(const FunctionCallbackInfo<Value>& args) {
-    auto isolate = args.GetIsolate();
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
-
-    if(!args[0]->IsUndefined()) {
-      obj->time_offset_ = args[0]->IntegerValue();
-    }
+  void ShortDUID::Destructor(napi_env /*env*/, void* native_object, void* /*finalize_hint*/) {
+    delete static_cast<ShortDUID*>(native_object);
+  }
 
-    std::string offset_str(std::to_string(obj->time_offset_));
+  ShortDUID* ShortDUID::Unwrap(napi_env env, napi_callback_info info, size_t argc, napi_value* argv) {
+    // Fills argv, missing arguments read as undefined
+    size_t wanted = argc;
+    napi_value self;
+    napi_get_cb_info(env, info, &argc, argv, &self, nullptr);
+    for(size_t i = argc; i < wanted; ++i) napi_get_undefined(env, &argv[i]);
 
-    args.GetReturnValue().Set(String::NewFromUtf8(isolate, offset_str.c_str()));
+    ShortDUID* obj = nullptr;
+    napi_unwrap(env, self, reinterpret_cast<void**>(&obj));
+    return obj;
   }
 
-  void ShortDUID::GetCurrentTimeMs(const FunctionCallbackInfo<Value>& args) {
-    auto isolate = args.GetIsolate();
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
+  napi_value ShortDUID::DriftTime(napi_env env, napi_callback_info info) {
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
+
+    if(!IsUndefined(env, args[0])) {
+      obj->generator->SetTimeOffset(ToInteger(env, args[0]));
+    }
+
+    std::string offset_str(std::to_string(obj->generator->GetTimeOffset()));
 
-    uint64_t milliseconds_since_epoch = obj->mono_epoch_diff_ + (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return NewString(env, offset_str);
+  }
 
-    std::string milliseconds_since_epoch_str(std::to_string(milliseconds_since_epoch));
+  napi_value ShortDUID::GetCurrentTimeMs(napi_env env, napi_callback_info info) {
+    auto obj = Unwrap(env, info);
+    if (!obj) return nullptr;
 
-    args.GetReturnValue().Set(String::NewFromUtf8(isolate, milliseconds_since_epoch_str.c_str()));
+    return NewDecimalString(env, obj->generator->GetCurrentTimeMs());
   }
 
-  void ShortDUID::GetDUIDInt(const FunctionCallbackInfo<Value>& args) {
-    // Method to return unique uint64 integers in a string form, wrapped in JS array
-    auto isolate = args.GetIsolate();
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
+  napi_value ShortDUID::GetDUIDInt(napi_env env, napi_callback_info info) {
+    // Method to return unique uint64 integers in decimal
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
 
-    unsigned short cnt   = std::abs(args[0]->IsUndefined() ? 1 : args[0]->IntegerValue());
+    unsigned short cnt   = std::abs(ToInteger(env, args[0], 1));
     cnt = (cnt > 8192) ? 1 : cnt; // Check boundaries
-    v8::Handle<v8::Array> numArr = v8::Array::New( isolate, cnt );
+    uint64_t stack_ids[64]; // Heap only for large batches
+    std::vector<uint64_t> heap_ids(cnt > 64 ? cnt : 0);
+    uint64_t* ids = heap_ids.empty() ? stack_ids : heap_ids.data();
+    obj->GenerateIDs(ids, cnt);
 
-    for(auto i = 0; i < cnt; ++i) {
-      numArr->Set( v8::Number::New(isolate, i), String::NewFromUtf8(isolate, std::to_string(obj->GetUniqueID(args)).c_str()) );
+    return NewDecimalArray(env, ids, cnt);
+  }
+
+  napi_value ShortDUID::FillDUIDInt(napi_env env, napi_callback_info info) {
+    // Method to write unique uint64 integers straight into BigUint64Array or Buffer, no per ID JS objects and no count limit
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
+
+    char* data = nullptr;
+    size_t cnt = 0;
+
+    bool is_buffer = false;
+    napi_is_buffer(env, args[0], &is_buffer);
+    if (is_buffer) {
+      size_t len = 0;
+      napi_get_buffer_info(env, args[0], reinterpret_cast<void**>(&data), &len);
+      cnt = len / sizeof(uint64_t); // Trailing bytes that do not fit whole ID are left alone
+    } else if (!GetTypedArray(env, args[0], napi_biguint64_array, reinterpret_cast<void**>(&data), &cnt)) {
+      napi_throw_type_error(env, nullptr, "target must be a BigUint64Array or Buffer");
+      return nullptr;
+    }
+
+    if (reinterpret_cast<uintptr_t>(data) % alignof(uint64_t) == 0) {
+      obj->GenerateIDs(reinterpret_cast<uint64_t*>(data), cnt);
+    } else {
+      // Buffer slices do not have to be 8 byte aligned, go through aligned chunks
+      uint64_t ids[512];
+      for(size_t i = 0; i < cnt; i += 512) {
+        size_t chunk = std::min<size_t>(cnt - i, 512);
+        obj->GenerateIDs(ids, chunk);
+        std::memcpy(data + i * sizeof(uint64_t), ids, chunk * sizeof(uint64_t)); // Host byte order
+      }
     }
 
-    args.GetReturnValue().Set(numArr);
+    return NewNumber(env, cnt);
   }
 
-  void ShortDUID::GetDUID(const FunctionCallbackInfo<Value>& args) {
-    // Method to return unique hashed IDs in a string form, wrapped in JS array
-    auto isolate = args.GetIsolate();
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
+  napi_value ShortDUID::GetDUIDBigInt(napi_env env, napi_callback_info info) {
+    auto obj = Unwrap(env, info);
+    if (!obj) return nullptr;
 
-    unsigned short cnt   = std::abs(args[0]->IsUndefined() ? 1 : args[0]->IntegerValue());
-    cnt = (cnt > 8192) ? 1 : cnt; // Check boundaries
-    v8::Handle<v8::Array> strArr = v8::Array::New( isolate, cnt );
+    napi_value ret = nullptr;
+    napi_create_bigint_uint64(env, obj->GenerateID(), &ret);
+    return ret;
+  }
+
+  napi_value ShortDUID::GetDUIDAsync(napi_env env, napi_callback_info info) {
+    // Promise of a Buffer with count newline terminated hashids, generated and encoded off the event loop
+    return QueueBatch(env, info, true);
+  }
+
+  napi_value ShortDUID::GetDUIDIntAsync(napi_env env, napi_callback_info info) {
+    // Promise of a BigUint64Array with count unique IDs, generated off the event loop
+    return QueueBatch(env, info, false);
+  }
 
-    for(unsigned short i = 0; i < cnt; ++i) {
-      strArr->Set( v8::Number::New(isolate, i), String::NewFromUtf8(isolate, obj->hash.encode({obj->GetUniqueID(args)}).c_str()) );
+  napi_value ShortDUID::QueueBatch(napi_env env, napi_callback_info info, bool encode) {
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
+
+    napi_value promise;
+    std::unique_ptr<AsyncBatch> batch(new AsyncBatch());
+    if (napi_create_promise(env, &batch->deferred, &promise) != napi_ok) return nullptr;
+
+    // No silent clamping here, whole point is large batches; bound is what fits one Buffer on older node.js
+    int64_t cnt = ToInteger(env, args[0], 1);
+    size_t max_length = encode ? obj->hash.max_length() + 1 : sizeof(uint64_t);
+    if (cnt < 0 || (uint64_t) cnt > INT32_MAX / max_length) {
+      napi_value error;
+      napi_create_range_error(env, nullptr, NewString(env, "count must be between 0 and " + std::to_string(INT32_MAX / max_length)), &error);
+      napi_reject_deferred(env, batch->deferred, error);
+      return promise;
     }
 
-    args.GetReturnValue().Set(strArr);
+    batch->generator = obj->generator;
+    if (obj->prefetch) batch->floor = obj->prefetch->GetFloor();
+    if (encode) batch->hash.reset(new hashidsxx::Hashids(obj->hash));
+    batch->cnt = (size_t) cnt;
+    batch->data = nullptr;
+    batch->len = 0;
+
+    napi_value resource_name;
+    napi_create_string_utf8(env, encode ? "ShortDUID.getDUIDAsync" : "ShortDUID.getDUIDIntAsync", NAPI_AUTO_LENGTH, &resource_name);
+    if (napi_create_async_work(env, nullptr, resource_name, ExecuteBatch, CompleteBatch, batch.get(), &batch->work) != napi_ok) {
+      return RejectBatch(env, batch.get(), promise, "could not create async work");
+    }
+    if (napi_queue_async_work(env, batch->work) != napi_ok) {
+      napi_delete_async_work(env, batch->work);
+      return RejectBatch(env, batch.get(), promise, "could not queue async work");
+    }
+    batch.release(); // CompleteBatch owns it now
+    return promise;
   }
 
-  void ShortDUID::HashidEncode(const FunctionCallbackInfo<Value>& args) {
-    auto isolate = args.GetIsolate();
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
+  napi_value ShortDUID::GetDUID(napi_env env, napi_callback_info info) {
+    // Method to return unique hashed IDs
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
 
-    if (args[0]->IsArray()) {
-      v8::Handle<v8::Array> numArr = v8::Handle<v8::Array>::Cast(args[0]);
-      std::vector<uint64_t> v;
-      // Check boundaries
-      if( numArr->Length() <= 64 ) {
-        v.reserve(numArr->Length());
-        for (unsigned short i = 0; i < numArr->Length(); ++i) {
-          String::Utf8Value u_uint64(numArr->Get(i)->ToString());
-          auto IntVal(std::strtoull(*u_uint64, NULL, 10));
-          v.push_back(IntVal);
-        }
+    unsigned short cnt   = std::abs(ToInteger(env, args[0], 1));
+    cnt = (cnt > 8192) ? 1 : cnt; // Check boundaries
+    auto stride = obj->hash.max_length();
+
+    // Stack for the usual handful of IDs, heap only for large batches. Hashid i starts at offsets[i] and ends where
+    // the next one starts
+    char stack_buf[1024];
+    uint64_t stack_ids[64];
+    uint32_t stack_offsets[65];
+    std::vector<char> heap_buf(cnt * stride > sizeof(stack_buf) ? cnt * stride : 0);
+    std::vector<uint64_t> heap_ids(cnt > 64 ? cnt : 0);
+    std::vector<uint32_t> heap_offsets(cnt > 64 ? cnt + 1 : 0);
+    char* buf = heap_buf.empty() ? stack_buf : heap_buf.data();
+    uint64_t* ids = heap_ids.empty() ? stack_ids : heap_ids.data();
+    uint32_t* offsets = heap_offsets.empty() ? stack_offsets : heap_offsets.data();
+
+    if(obj->prefetch) {
+      // Already encoded, a copy out of the ring; hashid i at i * stride, its length in offsets[i]
+      obj->prefetch->Take(cnt, buf, offsets);
+      return NewStringArray(env, cnt, [&](size_t i, size_t& len) {
+        len = offsets[i];
+        return buf + i * stride;
+      });
+    }
+
+    obj->generator->GetUniqueIDs(ids, cnt);
+    obj->hash.encode_many(ids, cnt, buf, offsets, -1);
+    return NewStringArray(env, cnt, [&](size_t i, size_t& len) {
+      len = offsets[i + 1] - offsets[i];
+      return buf + offsets[i];
+    });
+  }
+
+  napi_value ShortDUID::HashidEncode(napi_env env, napi_callback_info info) {
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
+
+    bool is_array = false;
+    napi_is_array(env, args[0], &is_array);
+    if (!is_array) return nullptr;
+
+    uint32_t length = 0;
+    napi_get_array_length(env, args[0], &length);
+    std::vector<uint64_t> v;
+    // Check boundaries
+    if( length <= 64 ) {
+      v.reserve(length);
+      for (uint32_t i = 0; i < length; ++i) {
+        napi_value element;
+        napi_get_element(env, args[0], i, &element);
+        v.push_back(ToID(env, element)); // BigInt, number or decimal string
       }
+    }
+
+    std::string _hash(obj->hash.encode(v.begin(), v.end()));
+    return NewAsciiString(env, _hash.data(), _hash.size());
+  }
 
-      std::string _hash(obj->hash.encode(v.begin(), v.end()));
-      args.GetReturnValue().Set(String::NewFromUtf8(isolate, _hash.c_str()));
+  napi_value ShortDUID::HashidDecode(napi_env env, napi_callback_info info) {
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
+
+    uint64_t v_uInt64_[64]; // Same limit as hashidEncode, anything holding more numbers decodes to nothing
+    size_t cnt = 0;
+    // Check stringness and boundaries, we do not want to have opportunity for DOS here. Copied straight onto the stack,
+    // anything that does not fit in 1024 bytes is longer than 1024 characters or not ASCII, and no hashid either way
+    char hash_[1026];
+    size_t hash_len = 0;
+    if(napi_get_value_string_utf8(env, args[0], hash_, sizeof(hash_), &hash_len) == napi_ok && hash_len <= 1024) {
+      cnt = obj->hash.decode(hash_, hash_len, v_uInt64_, 64); // Rejects foreign, overflowing and non-canonical input early
     }
+
+    return NewDecimalArray(env, v_uInt64_, cnt);
   }
 
-  void ShortDUID::HashidDecode(const FunctionCallbackInfo<Value>& args) {
-    auto isolate = args.GetIsolate();
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
+  napi_value ShortDUID::EncodeMany(napi_env env, napi_callback_info info) {
+    // Independent hashid for every number of a BigUint64Array, all packed into one Buffer: one call for the whole batch
+    // instead of one per ID
+    napi_value args[2];
+    auto obj = Unwrap(env, info, 2, args);
+    if (!obj) return nullptr;
+
+    const uint64_t* numbers = nullptr;
+    size_t cnt = 0;
+    if (!GetTypedArray(env, args[0], napi_biguint64_array, (void**)&numbers, &cnt)) return nullptr;
+
+    int delimiter = ToDelimiter(env, args[1]); // Without delimiter hashes are found through offsets
+
+    size_t max_length = obj->hash.max_length() + (delimiter >= 0 ? 1 : 0);
+    if (cnt > INT32_MAX / max_length) { // Offsets and older node.js Buffer lengths are 32 bit, keeps cnt * max_length small
+      napi_throw_range_error(env, nullptr, "encodeMany: too many numbers for one call");
+      return nullptr;
+    }
+
+    // Offsets go straight into the ArrayBuffer handed back
+    napi_value offsets_buffer = nullptr;
+    uint32_t* offsets = nullptr;
+    if (delimiter < 0) {
+      napi_create_arraybuffer(env, (cnt + 1) * sizeof(uint32_t), reinterpret_cast<void**>(&offsets), &offsets_buffer);
+      if (!offsets) return nullptr;
+    }
+
+    // Worst case up front, shrunk to what was written before the Buffer takes it over
+    char* data = static_cast<char*>(std::malloc(std::max<size_t>(cnt * max_length, 1)));
+    if (!data) {
+      napi_throw_range_error(env, nullptr, "encodeMany: out of memory for this many numbers");
+      return nullptr;
+    }
+    size_t len = obj->hash.encode_many(numbers, cnt, data, offsets, delimiter);
+    char* shrunk = static_cast<char*>(std::realloc(data, std::max<size_t>(len, 1)));
+    data = shrunk ? shrunk : data;
+    napi_value buffer = nullptr;
+    if (napi_create_external_buffer(env, len, data, FreeBuffer, nullptr, &buffer) != napi_ok) {
+      std::free(data);
+      return nullptr;
+    }
+
+    if (delimiter >= 0) {
+      return buffer;
+    }
+
+    napi_value offsets_arr, ret;
+    napi_create_typedarray(env, napi_uint32_array, cnt + 1, offsets_buffer, 0, &offsets_arr);
+    napi_create_object(env, &ret);
+    napi_set_named_property(env, ret, "data", buffer);
+    napi_set_named_property(env, ret, "offsets", offsets_arr);
+
+    return ret;
+  }
 
-    std::vector<uint64_t> v_uInt64_;
-    // Check stringness and boundaries, we do not want to have opportunity for DOS here
-    if(args[0]->IsString() && args[0]->ToString()->Length() <= 1024) {
-      String::Utf8Value hash_(args[0]->ToString());
-      auto hash(*hash_);
-      v_uInt64_ = obj->hash.decode(hash);
+  napi_value ShortDUID::DecodeMany(napi_env env, napi_callback_info info) {
+    // Many single number hashids out of one Buffer, newline separated or located by offsets like encodeMany returns
+    // them, decoded straight into typed arrays
+    napi_value args[2];
+    auto obj = Unwrap(env, info, 2, args);
+    if (!obj) return nullptr;
+
+    bool is_buffer = false;
+    napi_is_buffer(env, args[0], &is_buffer);
+    if (!is_buffer) return nullptr;
+    char* data = nullptr;
+    size_t len = 0;
+    napi_get_buffer_info(env, args[0], reinterpret_cast<void**>(&data), &len);
+
+    const uint32_t* offsets = nullptr;
+    size_t cnt = 0;
+    bool has_offsets = GetTypedArray(env, args[1], napi_uint32_array, (void**)&offsets, &cnt);
+    if (has_offsets) {
+      if (cnt == 0) return nullptr;
+      --cnt;
+    } else {
+      cnt = hashidsxx::Hashids::count_delimited(data, len, '\n');
     }
 
-    v8::Handle<v8::Array> numArr = v8::Array::New( isolate, v_uInt64_.size() );
-    for(unsigned short i = 0; i < v_uInt64_.size(); ++i) {
-      numArr->Set( v8::Number::New(isolate, i), String::NewFromUtf8(isolate, std::to_string(v_uInt64_[i]).c_str()) );
+    napi_value values_buffer, valid_buffer;
+    uint64_t* values = nullptr;
+    uint8_t* valid = nullptr;
+    napi_create_arraybuffer(env, cnt * sizeof(uint64_t), reinterpret_cast<void**>(&values), &values_buffer);
+    napi_create_arraybuffer(env, (cnt + 7) / 8, reinterpret_cast<void**>(&valid), &valid_buffer);
+    if (cnt > 0 && (!values || !valid)) return nullptr;
+
+    if (has_offsets) {
+      obj->hash.decode_many(data, len, offsets, cnt, values, valid);
+    } else {
+      obj->hash.decode_many(data, len, '\n', values, valid);
     }
 
-    args.GetReturnValue().Set(numArr);
+    napi_value values_arr, valid_arr, ret;
+    napi_create_typedarray(env, napi_biguint64_array, cnt, values_buffer, 0, &values_arr);
+    napi_create_typedarray(env, napi_uint8_array, (cnt + 7) / 8, valid_buffer, 0, &valid_arr);
+    napi_create_object(env, &ret);
+    napi_set_named_property(env, ret, "values", values_arr);
+    napi_set_named_property(env, ret, "valid", valid_arr);
+
+    return ret;
   }
 
-  void ShortDUID::GetShardID(const FunctionCallbackInfo<Value>& args) {
-    auto isolate = args.GetIsolate();
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
+  napi_value ShortDUID::GetSortableID(napi_env env, napi_callback_info info) {
+    // Method to return unique IDs as sortable keys
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
+
+    unsigned short cnt   = std::abs(ToInteger(env, args[0], 1));
+    cnt = (cnt > 8192) ? 1 : cnt; // Check boundaries
 
-    args.GetReturnValue().Set(Number::New(isolate, obj->shard_id_));
+    // Fixed width, so the stack does for up to 64 IDs
+    char stack_buf[64 * SortableCodec::WIDTH];
+    uint64_t stack_ids[64];
+    std::vector<char> heap_buf(cnt > 64 ? cnt * SortableCodec::WIDTH : 0);
+    std::vector<uint64_t> heap_ids(cnt > 64 ? cnt : 0);
+    char* buf = heap_buf.empty() ? stack_buf : heap_buf.data();
+    uint64_t* ids = heap_ids.empty() ? stack_ids : heap_ids.data();
+
+    obj->GenerateIDs(ids, cnt);
+    obj->sortable.EncodeMany(ids, cnt, buf);
+    return NewStringArray(env, cnt, [&](size_t i, size_t& len) {
+      len = SortableCodec::WIDTH;
+      return buf + i * SortableCodec::WIDTH;
+    });
   }
 
-  void ShortDUID::GetEpochStart(const FunctionCallbackInfo<Value>& args) {
-    auto isolate = args.GetIsolate();
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
+  napi_value ShortDUID::EncodeSortable(napi_env env, napi_callback_info info) {
+    // Sortable key for every ID of a BigUint64Array, back to back into one Buffer, each followed by delimiter if given
+    napi_value args[2];
+    auto obj = Unwrap(env, info, 2, args);
+    if (!obj) return nullptr;
+
+    const uint64_t* ids = nullptr;
+    size_t cnt = 0;
+    if (!GetTypedArray(env, args[0], napi_biguint64_array, (void**)&ids, &cnt)) return nullptr;
+    int delimiter = ToDelimiter(env, args[1]);
+
+    size_t stride = SortableCodec::WIDTH + (delimiter >= 0 ? 1 : 0);
+    if (cnt > INT32_MAX / stride) { // Buffer lengths are 32 bit on older node.js
+      napi_throw_range_error(env, nullptr, "encodeSortable: too many IDs for one call");
+      return nullptr;
+    }
 
-    args.GetReturnValue().Set(String::NewFromUtf8(isolate, std::to_string(obj->epoch_start_).c_str()));
+    // Exact size up front, keys are fixed width
+    char* data = static_cast<char*>(std::malloc(std::max<size_t>(cnt * stride, 1)));
+    if (!data) return nullptr;
+    size_t len = obj->sortable.EncodeMany(ids, cnt, data, delimiter);
+    napi_value buffer = nullptr;
+    if (napi_create_external_buffer(env, len, data, FreeBuffer, nullptr, &buffer) != napi_ok) {
+      std::free(data);
+      return nullptr;
+    }
+    return buffer;
   }
 
-  void ShortDUID::GetSalt(const FunctionCallbackInfo<Value>& args) {
-    auto isolate = args.GetIsolate();
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
+  napi_value ShortDUID::DecodeSortable(napi_env env, napi_callback_info info) {
+    // IDs of a Buffer of keys as encodeSortable produces them, with the same delimiter, straight into typed arrays
+    napi_value args[2];
+    auto obj = Unwrap(env, info, 2, args);
+    if (!obj) return nullptr;
+
+    bool is_buffer = false;
+    napi_is_buffer(env, args[0], &is_buffer);
+    if (!is_buffer) return nullptr;
+    char* data = nullptr;
+    size_t len = 0;
+    napi_get_buffer_info(env, args[0], reinterpret_cast<void**>(&data), &len);
+    int delimiter = ToDelimiter(env, args[1]);
+
+    size_t cnt = SortableCodec::CountMany(len, delimiter);
+    if (cnt == 0 && len > 0) return nullptr; // Not keys of this width
+
+    napi_value values_buffer, valid_buffer;
+    uint64_t* values = nullptr;
+    uint8_t* valid = nullptr;
+    napi_create_arraybuffer(env, cnt * sizeof(uint64_t), reinterpret_cast<void**>(&values), &values_buffer);
+    napi_create_arraybuffer(env, (cnt + 7) / 8, reinterpret_cast<void**>(&valid), &valid_buffer);
+    if (cnt > 0 && (!values || !valid)) return nullptr;
+
+    obj->sortable.DecodeMany(data, len, delimiter, values, valid);
+
+    napi_value values_arr, valid_arr, ret;
+    napi_create_typedarray(env, napi_biguint64_array, cnt, values_buffer, 0, &values_arr);
+    napi_create_typedarray(env, napi_uint8_array, (cnt + 7) / 8, valid_buffer, 0, &valid_arr);
+    napi_create_object(env, &ret);
+    napi_set_named_property(env, ret, "values", values_arr);
+    napi_set_named_property(env, ret, "valid", valid_arr);
+
+    return ret;
+  }
 
-    args.GetReturnValue().Set(String::NewFromUtf8(isolate, obj->salt_.c_str()));
+  napi_value ShortDUID::GetShardID(napi_env env, napi_callback_info info) {
+    auto obj = Unwrap(env, info);
+    if (!obj) return nullptr;
+
+    return NewNumber(env, obj->generator->GetShardID());
   }
 
-  void ShortDUID::GetRandomAPIKey(const v8::FunctionCallbackInfo<v8::Value>& args) {
-    auto isolate = args.GetIsolate();
-    const std::string urlsafe_alphabet = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  napi_value ShortDUID::GetEpochStart(napi_env env, napi_callback_info info) {
+    auto obj = Unwrap(env, info);
+    if (!obj) return nullptr;
 
-    unsigned short len   = args[0]->IsUndefined() ? 64 : args[0]->Uint32Value();
-    len = (len > 4096) ? 64 : len; //Check boundaries
+    return NewDecimalString(env, obj->generator->GetEpochStart());
+  }
+
+  napi_value ShortDUID::GetSalt(napi_env env, napi_callback_info info) {
+    auto obj = Unwrap(env, info);
+    if (!obj) return nullptr;
 
-    auto ret(ShortDUID::GetRandomString(len, urlsafe_alphabet));
-    args.GetReturnValue().Set(String::NewFromUtf8(isolate, ret.c_str()));
+    return NewString(env, obj->salt_);
   }
 
-  void ShortDUID::GetRandomPassword(const v8::FunctionCallbackInfo<v8::Value>& args) {
-    auto isolate = args.GetIsolate();
-    const std::string password_alphabet = "!#$%&()=-~^[{]};+:*_?/><0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  napi_value ShortDUID::ParseDUID(napi_env env, napi_callback_info info) {
+    // Timestamp (milliseconds since unix epoch), shard and sequence of one ID, or of a hashid or sortable key with format
+    // 'hashid' or 'sortable'
+    napi_value args[2];
+    auto obj = Unwrap(env, info, 2, args);
+    if (!obj) return nullptr;
+
+    uint64_t id = 0;
+    std::string format(IsUndefined(env, args[1]) ? "" : ToString(env, args[1]));
+    if (format == "hashid") {
+      std::string hashid(ToString(env, args[0]));
+      if (!obj->hash.decode_one(hashid.data(), hashid.size(), id)) return nullptr;
+    } else if (format == "sortable") {
+      std::string key(ToString(env, args[0]));
+      if (!obj->sortable.Decode(key.data(), key.size(), id)) return nullptr;
+    } else {
+      id = ToID(env, args[0]);
+    }
 
-    unsigned short len   = args[0]->IsUndefined() ? 16 : args[0]->Uint32Value();
-    len = (len > 1024) ? 16 : len; //Check boundaries
+    auto parts = obj->generator->Parse(id);
+    napi_value ret;
+    napi_create_object(env, &ret);
+    napi_set_named_property(env, ret, "timestamp", NewNumber(env, parts.timestamp_ms));
+    napi_set_named_property(env, ret, "shardId", NewNumber(env, parts.shard_id));
+    napi_set_named_property(env, ret, "sequence", NewNumber(env, parts.sequence));
 
-    auto ret(ShortDUID::GetRandomString(len, password_alphabet));
-    args.GetReturnValue().Set(String::NewFromUtf8(isolate, ret.c_str()));
+    return ret;
   }
 
-  std::string ShortDUID::GetRandomString(unsigned short len, const std::string &alphabet) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dis(0, alphabet.length() - 1);
+  napi_value ShortDUID::ParseMany(napi_env env, napi_callback_info info) {
+    // Columns out of a BigUint64Array of IDs, or of a Buffer of newline separated hashids like getDUIDAsync and
+    // encodeMany produce them; hashids also get the valid bitmap of decodeMany, invalid ones parse as 0
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
+
+    const uint64_t* ids = nullptr;
+    size_t cnt = 0;
+    std::vector<uint64_t> decoded;
+    napi_value valid_arr = nullptr;
+    bool is_buffer = false;
+    napi_is_buffer(env, args[0], &is_buffer); // Also true for any typed array on newer node.js, those go first
+    if (GetTypedArray(env, args[0], napi_biguint64_array, (void**)&ids, &cnt)) {
+      // IDs as they are
+    } else if (is_buffer) {
+      char* data = nullptr;
+      size_t len = 0;
+      napi_get_buffer_info(env, args[0], reinterpret_cast<void**>(&data), &len);
+      cnt = hashidsxx::Hashids::count_delimited(data, len, '\n');
+      decoded.resize(cnt);
+      napi_value valid_buffer;
+      uint8_t* valid = nullptr;
+      napi_create_arraybuffer(env, (cnt + 7) / 8, reinterpret_cast<void**>(&valid), &valid_buffer);
+      if (cnt > 0 && !valid) return nullptr;
+      obj->hash.decode_many(data, len, '\n', decoded.data(), valid);
+      napi_create_typedarray(env, napi_uint8_array, (cnt + 7) / 8, valid_buffer, 0, &valid_arr);
+      ids = decoded.data();
+    } else {
+      return nullptr;
+    }
 
-    std::string output;
-    output.reserve(len);
-    for(unsigned short i = 0; i < len; i++) {
-      output.push_back(alphabet[dis(gen)]);
+    napi_value timestamps_buffer, shards_buffer, sequences_buffer;
+    double* timestamps = nullptr;
+    uint32_t* shards = nullptr;
+    uint32_t* sequences = nullptr;
+    napi_create_arraybuffer(env, cnt * sizeof(double), reinterpret_cast<void**>(&timestamps), &timestamps_buffer);
+    napi_create_arraybuffer(env, cnt * sizeof(uint32_t), reinterpret_cast<void**>(&shards), &shards_buffer);
+    napi_create_arraybuffer(env, cnt * sizeof(uint32_t), reinterpret_cast<void**>(&sequences), &sequences_buffer);
+    if (cnt > 0 && (!timestamps || !shards || !sequences)) return nullptr;
+
+    // Timestamps are parsed as integers into the Float64Array's own memory, then turned into doubles in place
+    static_assert(sizeof(double) == sizeof(uint64_t), "timestamps are converted in place");
+    obj->generator->ParseMany(ids, cnt, reinterpret_cast<uint64_t*>(timestamps), shards, sequences);
+    for(size_t i = 0; i < cnt; ++i) {
+      uint64_t timestamp;
+      std::memcpy(&timestamp, &timestamps[i], sizeof(timestamp));
+      timestamps[i] = (double) timestamp;
     }
 
-    return output;
+    napi_value timestamps_arr, shards_arr, sequences_arr, ret;
+    napi_create_typedarray(env, napi_float64_array, cnt, timestamps_buffer, 0, &timestamps_arr);
+    napi_create_typedarray(env, napi_uint32_array, cnt, shards_buffer, 0, &shards_arr);
+    napi_create_typedarray(env, napi_uint32_array, cnt, sequences_buffer, 0, &sequences_arr);
+    napi_create_object(env, &ret);
+    napi_set_named_property(env, ret, "timestamp", timestamps_arr);
+    napi_set_named_property(env, ret, "shardId", shards_arr);
+    napi_set_named_property(env, ret, "sequence", sequences_arr);
+    if (valid_arr) napi_set_named_property(env, ret, "valid", valid_arr);
+
+    return ret;
   }
 
-  uint64_t ShortDUID::GetUniqueID(const v8::FunctionCallbackInfo<v8::Value>& args) {
-    // Generate distributed-safe unique ID based on milliseconds timestanp, sequence, and shard id
-    // 42 bits (not bytes) are for milliseconds, should fit 139 years of milliseconds
-    // 10 bits for shard ID, 2^10 shards (1024)
-    // 12 bits for atomic sequence, 2^12 unique numbers per millisecond (4096)
+  napi_value ShortDUID::MinIdForTime(napi_env env, napi_callback_info info) {
+    // Smallest ID of any shard in the millisecond, time as milliseconds since unix epoch (number or BigInt) or Date;
+    // with format 'sortable' the smallest key instead
+    napi_value args[2];
+    auto obj = Unwrap(env, info, 2, args);
+    if (!obj) return nullptr;
 
-    auto obj = ObjectWrap::Unwrap<ShortDUID>(args.Holder());
- 
-    // Get fresh milli time since epoch from monotonic clock
-    uint64_t milliseconds_since_epoch = obj->mono_epoch_diff_ + (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return NewIdBound(env, obj->sortable, obj->generator->MinIdForTime(ToTime(env, args[0])), args[1]);
+  }
 
-    // Create milliseconds since custom epoch, we want those numbers short
-    uint64_t milliseconds_since_this_epoch = milliseconds_since_epoch - (obj->epoch_start_ + obj->time_offset_);
+  napi_value ShortDUID::MaxIdForTime(napi_env env, napi_callback_info info) {
+    // Largest ID of any shard in the millisecond
+    napi_value args[2];
+    auto obj = Unwrap(env, info, 2, args);
+    if (!obj) return nullptr;
 
-    // Create submillisecond sequence number
-    uint64_t submilli_sequence = obj->sequence_.fetch_add(1, std::memory_order_relaxed); //Order is not important, only atomicity
-    submilli_sequence &= ((1ULL << 12) - 1); // Bitmask for the sequence, allows to go up to 4095
+    return NewIdBound(env, obj->sortable, obj->generator->MaxIdForTime(ToTime(env, args[0])), args[1]);
+  }
 
-    {
-      // Deal with sequence overflow within same time unit, XXX still experimental, need more testing
-      // Also, since iojs/nodejs are single-threaded, this "atomic" code is perhapse redundant. Maybe in the future this can be made
-      // multithreaded, if it will give speed advantages, doubt it will. It was fun to write though ...
-      bool overflow = false;
-      uint64_t milliseconds_since_this_epoch_copy(milliseconds_since_this_epoch);
+  napi_value ShortDUID::GetStats(napi_env env, napi_callback_info info) {
+    // Generator counters, optionally cleared after the snapshot is taken
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
 
-      std::atomic_thread_fence(std::memory_order_seq_cst); // Fence against anything that might access obj->ts_seq_[submilli_sequence] while in this block
-      overflow = std::atomic_compare_exchange_strong(&obj->ts_seq_[submilli_sequence], &milliseconds_since_this_epoch_copy, milliseconds_since_this_epoch + 1);
+    auto stats = obj->generator->GetStats(ToBoolean(env, args[0]));
 
-      if (overflow || milliseconds_since_this_epoch_copy > milliseconds_since_this_epoch) { // Second condition is not needed with steady clock will keep for tests
-        milliseconds_since_this_epoch = milliseconds_since_this_epoch_copy + 1; // Continue drifting time
-      }
+    napi_value ret;
+    napi_create_object(env, &ret);
+    napi_set_named_property(env, ret, "idsIssued", NewNumber(env, stats.ids_issued));
+    napi_set_named_property(env, ret, "sequenceOverflows", NewNumber(env, stats.sequence_overflows));
+    napi_set_named_property(env, ret, "clockRegressions", NewNumber(env, stats.clock_regressions));
+    napi_set_named_property(env, ret, "maxDriftMs", NewNumber(env, stats.max_drift_ms));
+    napi_set_named_property(env, ret, "currentDriftMs", NewNumber(env, stats.current_drift_ms));
 
-      milliseconds_since_this_epoch &= ((1ULL << 42) - 1); // We have only 42bit of space, overflow if not fitting
-      if(false == overflow) obj->ts_seq_[submilli_sequence].store(milliseconds_since_this_epoch); // Store timestamp of last used sequence number if we did not do it earlier
+    return ret;
+  }
+
+  napi_value ShortDUID::ResetStats(napi_env env, napi_callback_info info) {
+    auto obj = Unwrap(env, info);
+    if (!obj) return nullptr;
+
+    obj->generator->ResetStats();
+    return nullptr;
+  }
+
+  napi_value ShortDUID::GetDriftMs(napi_env env, napi_callback_info info) {
+    auto obj = Unwrap(env, info);
+    if (!obj) return nullptr;
+
+    return NewNumber(env, obj->generator->GetDriftMs());
+  }
+
+  napi_value ShortDUID::GetSequenceBudget(napi_env env, napi_callback_info info) {
+    auto obj = Unwrap(env, info);
+    if (!obj) return nullptr;
+
+    return NewNumber(env, obj->generator->GetSequenceBudget());
+  }
+
+  napi_value ShortDUID::GetRandomAPIKey(napi_env env, napi_callback_info info) {
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
+
+    unsigned short len   = ToUint32(env, args[0], 64);
+    len = (len > 4096) ? 64 : len; //Check boundaries
+
+    char key[4096]; // Filled in place, no std::string in between
+    obj->random.Fill(key, len, URLSAFE_ALPHABET);
+    return NewAsciiString(env, key, len);
+  }
+
+  napi_value ShortDUID::GetRandomPassword(napi_env env, napi_callback_info info) {
+    napi_value args[1];
+    auto obj = Unwrap(env, info, 1, args);
+    if (!obj) return nullptr;
+
+    unsigned short len   = ToUint32(env, args[0], 16);
+    len = (len > 1024) ? 16 : len; //Check boundaries
+
+    char password[1024];
+    obj->random.Fill(password, len, PASSWORD_ALPHABET);
+    return NewAsciiString(env, password, len);
+  }
+
+  napi_value ShortDUID::GetRandomAPIKeys(napi_env env, napi_callback_info info) {
+    // Many keys with one pool lock and one contiguous fill
+    napi_value args[2];
+    auto obj = Unwrap(env, info, 2, args);
+    if (!obj) return nullptr;
+
+    uint32_t cnt   = ToUint32(env, args[0], 1);
+    uint32_t len   = ToUint32(env, args[1], 64);
+    if (len > 4096) {
+      napi_throw_range_error(env, nullptr, "getRandomAPIKeys: length must be 0 to 4096");
+      return nullptr;
+    }
+    if (static_cast<uint64_t>(cnt) * (len + 1) > MAX_API_KEYS_BYTES) {
+      napi_throw_range_error(env, nullptr, "getRandomAPIKeys: too many keys for one call");
+      return nullptr;
     }
 
-    // Pack ID and return
-    return ((milliseconds_since_this_epoch) << 22) | ((obj->shard_id_) << 12) | submilli_sequence;
+    std::string keys(static_cast<size_t>(cnt) * len, '\0');
+    if (!keys.empty()) obj->random.Fill(&keys[0], keys.size(), URLSAFE_ALPHABET);
+    return NewStringArray(env, cnt, [&](size_t i, size_t& key_len) {
+      key_len = len;
+      return keys.data() + i * len;
+    });
   }
 
 }  // namespace shortduid
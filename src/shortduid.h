@@ -1,80 +1,103 @@
 #ifndef SHORTDUID_H
 #define SHORTDUID_H
 
-#include <node.h>
+#include <node_api.h>
 #include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
 #include <cstdint>
-#include <atomic>
 #include <algorithm>
 #include <vector>
-#include <chrono>
-#include <random>
-#include <iostream>
-#include <sstream>
-#include <limits>
-#include <limits.h>
-#include <sys/time.h>
-#include <stdlib.h>
-#include "../hashids/hashids.h"
-#include <node_object_wrap.h>
+#include <memory>
+#include "hashids.h"
+#include "generator.h"
+#include "prefetch.h"
+#include "random.h"
+#include "sortable.h"
 
 
 namespace shortduid {
 
-  class ShortDUID : public node::ObjectWrap {
+  //
+  // N-API binding: ABI stable across node.js versions, no process wide V8 handles, so every environment (main thread
+  // and each worker_thread) gets its own constructor and instances
+  //
+  class ShortDUID {
   public:
-    static void Init(v8::Local<v8::Object> exports);
+    static napi_value Init(napi_env env, napi_value exports);
 
   private:
-    explicit ShortDUID(uint32_t shard_id = 0, std::string salt = "", uint64_t epoch_start = 0);
+    explicit ShortDUID(uint32_t shard_id = 0, std::string salt = "", uint64_t epoch_start = 0, bool shared = false, std::string segment = "", Generator::Layout layout = Generator::LAYOUT_42_10_12, unsigned int min_length = 0, std::string alphabet = DEFAULT_ALPHABET);
     ~ShortDUID();
 
     //
     // JS stuff
     //
-    static v8::Persistent<v8::Function> constructor;
-    static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static napi_value New(napi_env env, napi_callback_info info);
+    static void Destructor(napi_env env, void* native_object, void* finalize_hint);
+    static ShortDUID* Unwrap(napi_env env, napi_callback_info info, size_t argc = 0, napi_value* argv = nullptr);
     //
     // Main methods
     //
-    static void GetDUIDInt(const v8::FunctionCallbackInfo<v8::Value>& args);
-    static void GetDUID(const v8::FunctionCallbackInfo<v8::Value>& args);
-    static void GetShardID(const v8::FunctionCallbackInfo<v8::Value>& args);
-    static void GetEpochStart(const v8::FunctionCallbackInfo<v8::Value>& args);
-    static void GetSalt(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static napi_value GetDUIDInt(napi_env env, napi_callback_info info);
+    static napi_value GetDUID(napi_env env, napi_callback_info info);
+    static napi_value FillDUIDInt(napi_env env, napi_callback_info info);
+    static napi_value GetDUIDBigInt(napi_env env, napi_callback_info info);
+    static napi_value GetDUIDAsync(napi_env env, napi_callback_info info);
+    static napi_value GetDUIDIntAsync(napi_env env, napi_callback_info info);
+    static napi_value QueueBatch(napi_env env, napi_callback_info info, bool encode);
+    static napi_value GetShardID(napi_env env, napi_callback_info info);
+    static napi_value GetEpochStart(napi_env env, napi_callback_info info);
+    static napi_value GetSalt(napi_env env, napi_callback_info info);
+    static napi_value ParseDUID(napi_env env, napi_callback_info info);
+    static napi_value ParseMany(napi_env env, napi_callback_info info);
+    static napi_value MinIdForTime(napi_env env, napi_callback_info info);
+    static napi_value MaxIdForTime(napi_env env, napi_callback_info info);
+    static napi_value GetStats(napi_env env, napi_callback_info info);
+    static napi_value ResetStats(napi_env env, napi_callback_info info);
+    static napi_value GetDriftMs(napi_env env, napi_callback_info info);
+    static napi_value GetSequenceBudget(napi_env env, napi_callback_info info);
     //
     // HashID stuff
     //
-    static void HashidEncode(const v8::FunctionCallbackInfo<v8::Value>& args);
-    static void HashidDecode(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static napi_value HashidEncode(napi_env env, napi_callback_info info);
+    static napi_value HashidDecode(napi_env env, napi_callback_info info);
+    static napi_value EncodeMany(napi_env env, napi_callback_info info);
+    static napi_value DecodeMany(napi_env env, napi_callback_info info);
+    //
+    // Sortable keys
+    //
+    static napi_value GetSortableID(napi_env env, napi_callback_info info);
+    static napi_value EncodeSortable(napi_env env, napi_callback_info info);
+    static napi_value DecodeSortable(napi_env env, napi_callback_info info);
     //
     // Only should be used for unit testing
     //
-    static void DriftTime(const v8::FunctionCallbackInfo<v8::Value>& args);
-    static void GetCurrentTimeMs(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static napi_value DriftTime(napi_env env, napi_callback_info info);
+    static napi_value GetCurrentTimeMs(napi_env env, napi_callback_info info);
     //
     // Password and key generators
     //
-    static void GetRandomAPIKey(const v8::FunctionCallbackInfo<v8::Value>& args);
-    static void GetRandomPassword(const v8::FunctionCallbackInfo<v8::Value>& args);
+    static napi_value GetRandomAPIKey(napi_env env, napi_callback_info info);
+    static napi_value GetRandomPassword(napi_env env, napi_callback_info info);
+    static napi_value GetRandomAPIKeys(napi_env env, napi_callback_info info);
     //
-    // Non JS methods
+    // IDs straight from the generator, every path but the ring of getDUID goes through here so it can keep the ring's
+    // floor, see core/prefetch.h
     //
-    static std::string GetRandomString(unsigned short len, const std::string &alphabet);
-    uint64_t GetUniqueID(const v8::FunctionCallbackInfo<v8::Value>& args);
+    void GenerateIDs(uint64_t* ids, size_t cnt);
+    uint64_t GenerateID();
     //
     // Class variables
     //
-    std::atomic_ullong sequence_;
-    std::atomic<uint64_t> ts_seq_[4096];
     std::string salt_;
-    uint64_t system_time_at_start_;
-    uint64_t mono_epoch_diff_;
-    uint64_t epoch_start_;
-    uint32_t shard_id_;
-    int64_t time_offset_;         //For testing only
 
+    std::shared_ptr<Generator> generator; // ID generator, own or process wide one, see core/generator.h
     hashidsxx::Hashids hash; // Hashid instance
+    SortableCodec sortable; // Order preserving keys, see core/sortable.h
+    RandomPool random; // Key and password source, see core/random.h
+    std::unique_ptr<Prefetcher> prefetch; // Encoded IDs ready for getDUID, null unless enabled; last, so it stops before hash goes
   };
 
 }  // namespace shortduid
@@ -74,6 +74,18 @@ describe( 'Short DUID', function () {
           .is( [ "123456", "7890", "123" ] );
     } );
 
+    it( 'should decode UINT64_MAX back without losing precision', function () {
+      test.value( duid_instance2.hashidDecode( duid_instance1.hashidEncode( [ "18446744073709551615" ] ) ) )
+          .is( [ "18446744073709551615" ] );
+    } );
+
+    it( 'should return empty array for hashids with foreign characters, overflow or non-canonical form', function () {
+      test.value( duid_instance1.hashidDecode( "LeG!r" ) ).is( [] );
+      test.value( duid_instance1.hashidDecode( "Le" + Array( 40 ).join( "G" ) ) ).is( [] );
+      test.value( duid_instance1.hashidDecode( "LeGxrLeGxr" ) ).is( [] );
+      test.value( duid_instance1.hashidDecode( "" ) ).is( [] );
+    } );
+
     it( 'should return different hashids given same value and different salt', function () {
       var duid_tmp1 = new init( 0, "salt#1", 0 );
       var duid_tmp2 = new init( 0, "salt#2", 0 );
@@ -126,6 +138,44 @@ describe( 'Short DUID', function () {
 
   } );
 
+  describe( '#getRandomAPIKeys()', function () {
+
+    it( 'should return requested number of URL-safe keys of requested length', function () {
+      var keys = duid_instance1.getRandomAPIKeys( 100, 32 );
+      test.array( keys ).hasLength( 100 );
+      keys.forEach( function ( key ) {
+        test.string( key ).hasLength( 32 ).match( /^[0-9a-zA-Z]+$/ );
+      } );
+    } );
+
+    it( 'should return distinct keys', function () {
+      var keys = duid_instance1.getRandomAPIKeys( 1000 );
+      test.number( _.uniq( keys ).length ).isEqualTo( 1000 );
+    } );
+
+    it( 'should default to one key 64 characters long', function () {
+      var keys = duid_instance2.getRandomAPIKeys();
+      test.array( keys ).hasLength( 1 );
+      test.string( keys[ 0 ] ).hasLength( 64 );
+    } );
+
+    it( 'should return empty keys and no keys', function () {
+      test.array( duid_instance1.getRandomAPIKeys( 3, 0 ) ).is( [ '', '', '' ] );
+      test.array( duid_instance1.getRandomAPIKeys( 0, 32 ) ).is( [] );
+    } );
+
+    it( 'should throw RangeError for too long keys and too many bytes', function () {
+      test.exception( function () {
+        duid_instance1.getRandomAPIKeys( 1, 4097 );
+      } ).isInstanceOf( RangeError );
+      test.exception( function () {
+        duid_instance1.getRandomAPIKeys( 1048576, 4096 );
+      } ).isInstanceOf( RangeError );
+      test.array( duid_instance1.getRandomAPIKeys( 16384, 1023 ) ).hasLength( 16384 );
+    } );
+
+  } );
+
   describe( '#getEpochStart()', function () {
 
     it( 'should return set epoch start, for instance #1: ' + epoch_start, function () {
@@ -261,6 +311,658 @@ describe( 'Short DUID', function () {
 
   } );
 
+  describe( '#fillDUIDInt() and #getDUIDBigInt()', function () {
+
+    it( 'should fill whole BigUint64Array with unique IDs, with no 8192 limit', function () {
+      var arr = new BigUint64Array( 20000 );
+      test.number( duid_instance1.fillDUIDInt( arr ) ).is( 20000 );
+      var ids = Array.from( arr, String );
+      test.array( _.uniq( ids ) ).hasLength( 20000 );
+      test.bool( ids.indexOf( "0" ) === -1 ).isTrue();
+    } );
+
+    it( 'should hand out strictly increasing IDs across single and batched calls', function () {
+      var arr = new BigUint64Array( 3 * 4096 + 7 );
+      var before = duid_instance1.getDUIDBigInt();
+      duid_instance1.fillDUIDInt( arr );
+      var after = duid_instance1.getDUIDBigInt();
+      test.bool( arr[ 0 ] > before ).isTrue();
+      for ( var i = 1; i < arr.length; i++ ) {
+        if ( arr[ i ] <= arr[ i - 1 ] ) throw new Error( 'ID #' + i + ' is not larger than previous one' );
+      }
+      test.bool( after > arr[ arr.length - 1 ] ).isTrue();
+    } );
+
+    it( 'should fill Buffer with as many whole 64 bit IDs as fit', function () {
+      var buf = Buffer.alloc( 8 * 5 + 3 );
+      test.number( duid_instance1.fillDUIDInt( buf ) ).is( 5 );
+      test.number( buf.readUInt8( 8 * 5 ) ).is( 0 );
+      test.string( buf.readBigUInt64LE( 0 ).toString() ).isNotEqualTo( buf.readBigUInt64LE( 8 ).toString() );
+    } );
+
+    it( 'should throw TypeError for anything that is not BigUint64Array or Buffer', function () {
+      [ [ 1, 2, 3 ], undefined, 'buffer', {} ].forEach( function ( target ) {
+        test.exception( function () {
+          duid_instance1.fillDUIDInt( target );
+        } ).isInstanceOf( TypeError );
+      } );
+    } );
+
+    it( 'should return single ID as BigInt with same shard ID bits as instance', function () {
+      var id = duid_instance1.getDUIDBigInt();
+      test.string( typeof id ).is( 'bigint' );
+      test.number( Number( ( id >> 12n ) & 1023n ) ).is( 123 );
+    } );
+
+  } );
+
+  describe( '#encodeMany()', function () {
+
+    var values = new BigUint64Array( [ 0n, 1n, 123456n, 18446744073709551615n ] );
+    var ids = new BigUint64Array( 1000 );
+    duid_instance1.fillDUIDInt( ids );
+
+    it( 'should return same hashes as hashidEncode of every single number, located by offsets', function () {
+      var res = duid_instance1.encodeMany( values );
+      test.number( res.offsets.length ).is( values.length + 1 );
+      test.number( res.offsets[ values.length ] ).is( res.data.length );
+      for ( var i = 0; i < values.length; i++ ) {
+        test.string( res.data.toString( 'latin1', res.offsets[ i ], res.offsets[ i + 1 ] ) )
+            .is( duid_instance1.hashidEncode( [ values[ i ].toString() ] ) );
+      }
+    } );
+
+    it( 'should put delimiter after every hash when asked to', function () {
+      var hashes = duid_instance1.encodeMany( ids, "\n" ).toString( 'latin1' ).split( "\n" );
+      test.number( hashes.length ).is( ids.length + 1 );
+      test.string( hashes[ ids.length ] ).is( "" );
+      test.array( _.uniq( hashes.slice( 0, ids.length ) ) ).hasLength( ids.length );
+      test.string( duid_instance2.hashidDecode( hashes[ 999 ] )[ 0 ] ).is( ids[ 999 ].toString() );
+    } );
+
+    it( 'should return empty result for empty array and undefined for anything else', function () {
+      test.number( duid_instance1.encodeMany( new BigUint64Array( 0 ) ).data.length ).is( 0 );
+      test.value( duid_instance1.encodeMany( [ 1, 2, 3 ] ) ).isUndefined();
+    } );
+
+  } );
+
+  describe( '#decodeMany()', function () {
+
+    var ids = new BigUint64Array( 1000 );
+    duid_instance1.fillDUIDInt( ids );
+
+    function isValid( res, i ) {
+      return ( res.valid[ i >> 3 ] >> ( i & 7 ) & 1 ) === 1;
+    }
+
+    it( 'should decode what encodeMany produced, located by offsets', function () {
+      var enc = duid_instance1.encodeMany( ids );
+      var res = duid_instance2.decodeMany( enc.data, enc.offsets );
+      test.number( res.values.length ).is( ids.length );
+      test.number( res.valid.length ).is( 125 );
+      for ( var i = 0; i < ids.length; i++ ) {
+        if ( res.values[ i ] !== ids[ i ] || !isValid( res, i ) ) throw new Error( 'ID #' + i + ' did not survive encode and decode' );
+      }
+    } );
+
+    it( 'should decode newline separated hashids and flag invalid ones', function () {
+      var lines = [ duid_instance1.hashidEncode( [ "123456" ] ), "not a hashid", duid_instance1.hashidEncode( [ 1, 2 ] ), duid_instance1.hashidEncode( [ "42" ] ) + "\r" ];
+      var res = duid_instance1.decodeMany( Buffer.from( lines.join( "\n" ) + "\n", 'latin1' ) );
+      test.number( res.values.length ).is( 4 );
+      test.string( res.values[ 0 ].toString() ).is( "123456" );
+      test.bool( isValid( res, 0 ) ).isTrue();
+      test.bool( isValid( res, 1 ) ).isFalse();
+      test.string( res.values[ 1 ].toString() ).is( "0" );
+      test.bool( isValid( res, 2 ) ).isFalse();
+      test.string( res.values[ 3 ].toString() ).is( "42" );
+      test.bool( isValid( res, 3 ) ).isTrue();
+    } );
+
+    it( 'should return undefined for anything that is not a Buffer', function () {
+      test.value( duid_instance1.decodeMany( "abc" ) ).isUndefined();
+    } );
+
+  } );
+
+  describe( '#getStats() and #resetStats()', function () {
+
+    var duid_instance_stats = new init( 1, salt, epoch_start );
+
+    it( 'should count issued IDs and sequence overflows', function () {
+      duid_instance_stats.getDUIDInt( 10 );
+      duid_instance_stats.fillDUIDInt( new BigUint64Array( 3 * 4096 ) );
+      var stats = duid_instance_stats.getStats();
+      test.number( stats.idsIssued ).is( 10 + 3 * 4096 );
+      test.number( stats.sequenceOverflows ).isGreaterThan( 1 );
+      test.number( stats.maxDriftMs ).isGreaterThan( 0 );
+      test.number( stats.currentDriftMs ).isGreaterThan( -1 );
+      test.number( stats.clockRegressions ).is( 0 );
+    } );
+
+    it( 'should clear counters when asked to', function () {
+      test.number( duid_instance_stats.getStats( true ).idsIssued ).isGreaterThan( 0 );
+      test.number( duid_instance_stats.getStats().idsIssued ).is( 0 );
+      duid_instance_stats.getDUID( 5 );
+      duid_instance_stats.resetStats();
+      test.number( duid_instance_stats.getStats().idsIssued ).is( 0 );
+      test.number( duid_instance_stats.getStats().maxDriftMs ).is( 0 );
+    } );
+
+    it( 'should count clock regressions', function () {
+      duid_instance_stats.getDUIDInt( 1 );
+      duid_instance_stats.driftTime( 1000 );
+      duid_instance_stats.getDUIDInt( 1 );
+      duid_instance_stats.driftTime( 0 );
+      test.number( duid_instance_stats.getStats().clockRegressions ).is( 1 );
+    } );
+
+  } );
+
+  describe( 'worker_threads', function () {
+
+    var Worker = require( 'worker_threads' ).Worker;
+    var script = [
+      "var worker_threads = require( 'worker_threads' );",
+      "var duid = require( worker_threads.workerData.index );",
+      "var instance = new duid.init( worker_threads.workerData.shard, worker_threads.workerData.salt, worker_threads.workerData.epoch_start, worker_threads.workerData.options );",
+      "worker_threads.parentPort.postMessage( instance.getDUIDInt( 1000 ).concat( instance.getDUID( 10 ) ) );"
+    ].join( "\n" );
+
+    var run_workers = function ( shard, options, callback ) {
+      async.times( 4, function ( n, next ) {
+        var worker = new Worker( script, { eval: true, workerData: { index: require.resolve( '../index' ), shard: shard === undefined ? n : shard, salt: salt, epoch_start: epoch_start, options: options } } );
+        worker.once( 'message', function ( worker_ids ) { next( null, worker_ids ); } );
+        worker.once( 'error', next );
+      }, callback );
+    };
+
+    it( 'should load in workers and produce unique IDs alongside the main thread', function ( done ) {
+      var ids = duid_instance1.getDUIDInt( 1000 );
+      run_workers( undefined, undefined, function ( err, results ) {
+        if ( err ) return done( err );
+        results.forEach( function ( worker_ids ) {
+          test.array( worker_ids ).hasLength( 1010 );
+          ids = ids.concat( worker_ids );
+        } );
+        test.bool( check_duplicates( ids ) ).isTrue();
+        done();
+      } );
+    } );
+
+    it( 'should produce unique IDs from one shard shared by the main thread and all workers', function ( done ) {
+      var duid_shared = new init( 321, salt, epoch_start, { shared: true } );
+      duid_shared.resetStats();
+      var ids = duid_shared.getDUIDInt( 1000 );
+      run_workers( 321, { shared: true }, function ( err, results ) {
+        if ( err ) return done( err );
+        results.forEach( function ( worker_ids ) {
+          test.array( worker_ids ).hasLength( 1010 );
+          ids = ids.concat( worker_ids.slice( 0, 1000 ) );
+        } );
+        test.bool( check_duplicates( ids ) ).isTrue();
+        test.number( duid_shared.getStats().idsIssued ).is( 5000 + 4 * 10 );
+        done();
+      } );
+    } );
+
+  } );
+
+  describe( 'shared memory generator', function () {
+
+    // Per run, so that runs do not see each other's segment; removed again afterwards
+    var shm_name = '/shortduid-mocha-' + process.pid;
+
+    after( function () {
+      try {
+        require( 'fs' ).unlinkSync( '/dev/shm' + shm_name );
+      } catch ( err ) {
+        // No /dev/shm outside Linux, nothing to clean up there
+      }
+    } );
+
+    var script = [
+      "var duid = require( process.argv[ 1 ] );",
+      "var instance = new duid.init( 321, process.argv[ 2 ], " + epoch_start + ", { shm: '" + shm_name + "' } );",
+      "process.stdout.write( JSON.stringify( instance.getDUIDInt( 5000 ).concat( instance.getDUIDInt( 5000 ) ) ) );"
+    ].join( "\n" );
+
+    it( 'should produce unique IDs from one shard shared by several processes', function ( done ) {
+      var execFile = require( 'child_process' ).execFile;
+      var duid_shm = new init( 321, salt, epoch_start, { shm: shm_name } );
+      var ids = duid_shm.getDUIDInt( 1000 );
+      async.times( 3, function ( n, next ) {
+        execFile( process.execPath, [ '-e', script, require.resolve( '../index' ), salt ], function ( err, stdout ) {
+          next( err, err ? null : JSON.parse( stdout ) );
+        } );
+      }, function ( err, results ) {
+        if ( err ) return done( err );
+        results.forEach( function ( child_ids ) {
+          test.array( child_ids ).hasLength( 10000 );
+          ids = ids.concat( child_ids );
+        } );
+        test.bool( check_duplicates( ids ) ).isTrue();
+        done();
+      } );
+    } );
+
+    it( 'should refuse a segment set up for another shard', function () {
+      test.exception( function () {
+        new init( 322, salt, epoch_start, { shm: shm_name } );
+      } ).match( /shard 321/ );
+    } );
+
+  } );
+
+  describe( 'high-water mark', function () {
+
+    var fs = require( 'fs' );
+    var path = require( 'path' ).join( require( 'os' ).tmpdir(), 'shortduid-mocha-' + process.pid + '.hwm' );
+
+    after( function () {
+      fs.unlinkSync( path );
+    } );
+
+    it( 'should resume above everything handed out before restart, even with the clock stepped back', function () {
+      var before_restart = new init( 123, salt, epoch_start, { highWaterMark: path, highWaterLeaseMs: 60000 } );
+      var id1 = new BN( before_restart.getDUIDInt( 1 )[ 0 ], 10 );
+      var after_restart = new init( 123, salt, epoch_start, { highWaterMark: path } );
+      after_restart.driftTime( 5000 );
+      var id2 = new BN( after_restart.getDUIDInt( 1 )[ 0 ], 10 );
+      test.bool( id2.shrn( 22 ).sub( id1.shrn( 22 ) ).gten( 60000 ) ).isTrue();
+    } );
+
+    it( 'should refuse a file kept for another shard', function () {
+      test.exception( function () {
+        new init( 124, salt, epoch_start, { highWaterMark: path } );
+      } ).match( /shard 123/ );
+    } );
+
+  } );
+
+  describe( '#parseDUID(), #parseMany(), #minIdForTime() and #maxIdForTime()', function () {
+
+    [ '42/10/12', '41/8/15' ].forEach( function ( layout ) {
+
+      var duid_parse = new init( 77, salt, epoch_start, { layout: layout } );
+
+      it( 'should take apart what it hands out, IDs and hashids, with layout ' + layout, function () {
+        var now = Date.now();
+        var id = duid_parse.getDUIDInt( 1 )[ 0 ];
+        var parts = duid_parse.parseDUID( id );
+        test.number( parts.shardId ).is( 77 );
+        test.number( Math.abs( parts.timestamp - now ) ).isLessThan( 1000 );
+        test.object( duid_parse.parseDUID( BigInt( id ) ) ).is( parts );
+        test.object( duid_parse.parseDUID( duid_parse.hashidEncode( [ id ] ), 'hashid' ) ).is( parts );
+        test.value( duid_parse.parseDUID( '!!', 'hashid' ) ).isUndefined();
+      } );
+
+      it( 'should parse columns matching parseDUID with layout ' + layout, function () {
+        var ids = new BigUint64Array( 5000 );
+        duid_parse.fillDUIDInt( ids );
+        var columns = duid_parse.parseMany( ids );
+        var hashid_columns = duid_parse.parseMany( duid_parse.encodeMany( ids, '\n' ) );
+        for ( var i = 0; i < ids.length; i += 499 ) {
+          var parts = duid_parse.parseDUID( ids[ i ] );
+          test.number( columns.timestamp[ i ] ).is( parts.timestamp );
+          test.number( columns.shardId[ i ] ).is( parts.shardId );
+          test.number( columns.sequence[ i ] ).is( parts.sequence );
+          test.number( hashid_columns.sequence[ i ] ).is( parts.sequence );
+        }
+      } );
+
+      it( 'should bound IDs of a millisecond exactly with layout ' + layout, function () {
+        var id = duid_parse.getDUIDBigInt();
+        var timestamp = duid_parse.parseDUID( id ).timestamp;
+        test.bool( duid_parse.minIdForTime( timestamp ) <= id && id <= duid_parse.maxIdForTime( timestamp ) ).isTrue();
+        test.bool( duid_parse.maxIdForTime( new Date( timestamp - 1 ) ) < id ).isTrue();
+        test.bool( duid_parse.maxIdForTime( timestamp ) + BigInt( 1 ) === duid_parse.minIdForTime( timestamp + 1 ) ).isTrue();
+      } );
+
+      it( 'should take the time as BigInt with layout ' + layout, function () {
+        var timestamp = duid_parse.parseDUID( duid_parse.getDUIDBigInt() ).timestamp;
+        test.bool( duid_parse.minIdForTime( BigInt( timestamp ) ) === duid_parse.minIdForTime( timestamp ) ).isTrue();
+        test.bool( duid_parse.maxIdForTime( BigInt( timestamp ) ) === duid_parse.maxIdForTime( timestamp ) ).isTrue();
+        test.bool( duid_parse.minIdForTime( BigInt( -1 ) ) === BigInt( 0 ) ).isTrue();
+        test.bool( duid_parse.maxIdForTime( BigInt( 2 ) ** BigInt( 70 ) ) === duid_parse.maxIdForTime( Number.MAX_SAFE_INTEGER ) ).isTrue();
+      } );
+
+    } );
+
+  } );
+
+  describe( 'bit layouts', function () {
+
+    [ [ '42/10/12', 10, 12 ], [ '41/8/15', 8, 15 ], [ '40/14/10', 14, 10 ] ].forEach( function ( layout ) {
+
+      it( 'should place shard and sequence according to layout ' + layout[ 0 ], function () {
+        var duid_layout = new init( 0xffffff, salt, epoch_start, { layout: layout[ 0 ] } );
+        var shard_mask = ( 1 << layout[ 1 ] ) - 1;
+        test.number( duid_layout.getShardID() ).is( shard_mask );
+        var ids = duid_layout.getDUIDInt( 8192 );
+        var now_ms = new BN( duid_layout.getCurrentTimeMs(), 10 ).subn( epoch_start );
+        var first = new BN( ids[ 0 ], 10 );
+        test.number( first.shrn( layout[ 2 ] ).andln( shard_mask ) ).is( shard_mask );
+        test.bool( now_ms.sub( first.shrn( layout[ 1 ] + layout[ 2 ] ) ).lten( 1000 ) ).isTrue();
+        test.array( _.uniq( ids ) ).hasLength( 8192 );
+      } );
+
+    } );
+
+    it( 'should throw on unknown layout', function () {
+      test.exception( function () {
+        new init( 1, salt, epoch_start, { layout: '42/11/12' } );
+      } ).match( /unknown ID layout/ );
+    } );
+
+  } );
+
+  describe( 'minLength and alphabet', function () {
+
+    it( 'should pad hashids as the reference implementations do', function () {
+      var duid_padded = new init( 1, 'this is my salt', epoch_start, { minLength: 8 } );
+      test.string( duid_padded.hashidEncode( [ 1 ] ) ).is( 'gB0NV05e' );
+      test.array( duid_padded.hashidDecode( 'gB0NV05e' ) ).is( [ '1' ] );
+      test.string( new init( 1, 'this is my salt', epoch_start, { alphabet: '0123456789abcdef' } ).hashidEncode( [ 1234567 ] ) ).is( 'b332db5' );
+    } );
+
+    it( 'should hand out hashids of exactly minLength from the alphabet', function () {
+      var duid_slug = new init( 1, salt, epoch_start, { minLength: 24, alphabet: 'abcdefghijklmnopqrstuvwxyz' } );
+      var ids = duid_slug.getDUID( 1000 );
+      ids.forEach( function ( id ) {
+        test.string( id ).match( /^[a-z]{24}$/ );
+      } );
+      test.bool( check_duplicates( ids.slice() ) ).isTrue();
+      test.array( duid_slug.hashidDecode( ids[ 0 ] ) ).hasLength( 1 );
+      test.array( duid_slug.hashidDecode( ids[ 0 ].slice( 1 ) ) ).is( [] );
+
+      var long_ids = new init( 1, salt, epoch_start, { minLength: 1024 } ).getDUID( 10 );
+      test.number( long_ids[ 9 ].length ).is( 1024 );
+    } );
+
+    it( 'should accept a comma in the alphabet', function () {
+      var duid_comma = new init( 1, salt, epoch_start, { minLength: 16, alphabet: ',abcdefghijklmnop' } );
+      var ids = duid_comma.getDUID( 1000 );
+      test.array( ids ).hasLength( 1000 );
+      test.bool( ids.some( function ( id ) { return id.indexOf( ',' ) >= 0; } ) ).isTrue();
+      test.array( duid_comma.hashidDecode( duid_comma.hashidEncode( [ 123456 ] ) ) ).is( [ '123456' ] );
+      test.array( duid_comma.hashidDecode( ids[ 0 ] ) ).hasLength( 1 );
+      test.bool( check_duplicates( ids.slice() ) ).isTrue();
+    } );
+
+    it( 'should throw on bad minLength or alphabet', function () {
+      test.exception( function () {
+        new init( 1, salt, epoch_start, { minLength: 1025 } );
+      } ).isInstanceOf( RangeError );
+      [ 'abcdefghijklmno', 'abcdefghijklmnoo', 'abcdefghijklmno p' ].forEach( function ( alphabet ) {
+        test.exception( function () {
+          new init( 1, salt, epoch_start, { alphabet: alphabet } );
+        } ).match( /alphabet must be/ );
+      } );
+    } );
+
+  } );
+
+  describe( '#getSortableID(), #encodeSortable() and #decodeSortable()', function () {
+
+    [ 'base62', 'base64url' ].forEach( function ( alphabet ) {
+
+      var duid_sortable = new init( 123, salt, epoch_start, { sortable: alphabet } );
+      var duid_keyed = new init( 123, salt, epoch_start, { sortable: alphabet, sortableKey: 'secret' } );
+
+      it( 'should hand out fixed width keys sorting like their IDs with ' + alphabet, function () {
+        var keys = duid_sortable.getSortableID( 8192 );
+        test.array( keys ).hasLength( 8192 );
+        test.array( keys.slice().sort() ).is( keys );
+        test.bool( check_duplicates( keys.slice() ) ).isTrue();
+        keys.forEach( function ( key ) {
+          test.string( key ).match( /^[-0-9A-Z_a-z]{11}$/ );
+        } );
+        test.object( duid_sortable.parseDUID( keys[ 0 ], 'sortable' ) ).hasProperty( 'shardId', 123 );
+      } );
+
+      it( 'should keep keys ordered by millisecond with a key with ' + alphabet, function () {
+        var keys = duid_keyed.getSortableID( 8192 );
+        var times = keys.map( function ( key ) {
+          return duid_keyed.parseDUID( key, 'sortable' ).timestamp;
+        } );
+        var time = times[ 0 ];
+        test.bool( keys[ 0 ] >= duid_keyed.minIdForTime( time, 'sortable' ) && keys[ 0 ] <= duid_keyed.maxIdForTime( time, 'sortable' ) ).isTrue();
+        for ( var i = 1; i < keys.length; ++i ) {
+          if ( times[ i ] < times[ i - 1 ] || ( times[ i ] > times[ i - 1 ] && keys[ i ] <= keys[ i - 1 ] ) ) throw new Error( 'keys out of order at ' + i );
+        }
+        test.object( duid_keyed.parseDUID( keys[ 0 ], 'sortable' ) ).hasProperty( 'shardId', 123 );
+      } );
+
+      it( 'should encode and decode batches, with and without delimiter, with ' + alphabet, function () {
+        var ids = new BigUint64Array( 1000 );
+        duid_keyed.fillDUIDInt( ids );
+        var data = duid_keyed.encodeSortable( ids );
+        test.number( data.length ).is( 11000 );
+        test.array( Array.from( duid_keyed.decodeSortable( data ).values ) ).is( Array.from( ids ) );
+        var lines = duid_keyed.encodeSortable( ids, "\n" );
+        test.array( Array.from( duid_keyed.decodeSortable( lines, "\n" ).values ) ).is( Array.from( ids ) );
+        test.string( lines.toString( 'latin1' ).split( "\n" )[ 1 ] ).is( data.toString( 'latin1', 11, 22 ) );
+
+        data[ 0 ] = 0x21; // '!'
+        var res = duid_keyed.decodeSortable( data );
+        test.number( res.valid[ 0 ] ).is( 0xfe );
+        test.string( String( res.values[ 0 ] ) ).is( '0' );
+        test.value( duid_keyed.decodeSortable( Buffer.from( 'too short' ) ) ).isUndefined();
+      } );
+
+    } );
+
+    it( 'should throw on unknown alphabet', function () {
+      test.exception( function () {
+        new init( 1, salt, epoch_start, { sortable: 'base32' } );
+      } ).match( /unknown sortable alphabet/ );
+    } );
+
+  } );
+
+  describe( 'time sources', function () {
+
+    [ 'coarse', 'ticker' ].forEach( function ( time_source ) {
+
+      it( 'should follow the clock and keep IDs monotonic with ' + time_source + ' time source and drifting time', function () {
+        var duid_clock = new init( 123, salt, epoch_start, { timeSource: time_source } );
+        test.number( Math.abs( parseInt( duid_clock.getCurrentTimeMs(), 10 ) - Date.now() ) ).isLessThan( 1000 );
+        var id1 = new BN( duid_clock.getDUIDInt( 1 )[ 0 ], 10 );
+        duid_clock.driftTime( -5000 );
+        var id2 = new BN( duid_clock.getDUIDInt( 4096 )[ 4095 ], 10 );
+        test.bool( id2.cmp( id1 ) === 1 ).isTrue();
+        test.string( duid_clock.driftTime( 0 ) ).is( '0' );
+      } );
+
+    } );
+
+  } );
+
+  describe( '#getDUIDAsync() and #getDUIDIntAsync()', function () {
+
+    var duid_async = new init( 123, salt, epoch_start );
+
+    it( 'should mint large batches off the event loop, unique against synchronous calls made meanwhile', function () {
+      var sync_ids = [];
+      var timer = setInterval( function () {
+        sync_ids = sync_ids.concat( duid_async.getDUIDInt( 100 ) );
+      }, 0 );
+      return Promise.all( [ duid_async.getDUIDIntAsync( 200000 ), duid_async.getDUIDAsync( 50000 ) ] ).then( function ( results ) {
+        clearInterval( timer );
+        var ints = results[ 0 ];
+        test.number( ints.length ).is( 200000 );
+        for ( var i = 1; i < ints.length; ++i ) {
+          if ( ints[ i ] <= ints[ i - 1 ] ) throw new Error( 'IDs out of order at ' + i );
+        }
+        var decoded = duid_async.decodeMany( results[ 1 ] ).values;
+        test.number( decoded.length ).is( 50000 );
+        var all = Array.from( ints, String ).concat( Array.from( decoded, String ), sync_ids );
+        test.bool( check_duplicates( all ) ).isTrue();
+      } );
+    } );
+
+    it( 'should reject a negative count with RangeError', function () {
+      return duid_async.getDUIDIntAsync( -1 ).then( function () {
+        throw new Error( 'should not resolve' );
+      }, function ( err ) {
+        test.object( err ).isInstanceOf( RangeError );
+      } );
+    } );
+
+  } );
+
+  describe( '#createIDStream()', function () {
+
+    var duid_stream = new init( 123, salt, epoch_start );
+
+    it( 'should stream ascending numeric IDs without drifting ahead of the clock', function ( done ) {
+      var prev = BigInt( 0 );
+      var cnt = 0;
+      duid_stream.resetStats();
+      duid_stream.createIDStream( { count: 100000, chunkSize: 4096 } ).on( 'data', function ( chunk ) {
+        for ( var i = 0; i < chunk.length; i += 8 ) {
+          var id = chunk.readBigUInt64LE( i );
+          if ( id <= prev ) return done( new Error( 'IDs out of order' ) );
+          prev = id;
+          ++cnt;
+        }
+      } ).on( 'end', function () {
+        test.number( cnt ).is( 100000 );
+        test.number( duid_stream.getStats().maxDriftMs ).isLessThan( 2 );
+        done();
+      } );
+    } );
+
+    it( 'should never emit an ID with a timestamp ahead of the clock', function ( done ) {
+      var ahead = 0;
+      duid_stream.createIDStream( { count: 50000, chunkSize: 65536 } ).on( 'data', function ( chunk ) {
+        var now_ms = BigInt( duid_stream.getCurrentTimeMs() );
+        for ( var i = 0; i < chunk.length; i += 8 ) {
+          if ( ( chunk.readBigUInt64LE( i ) >> BigInt( 22 ) ) + BigInt( epoch_start ) > now_ms ) ++ahead;
+        }
+      } ).on( 'end', function () {
+        test.number( ahead ).is( 0 );
+        done();
+      } );
+    } );
+
+    it( 'should report the sequence budget of the current millisecond', function () {
+      var duid_budget = new init( 123, salt, epoch_start );
+      test.number( duid_budget.getDriftMs() ).is( 0 );
+      test.number( duid_budget.getSequenceBudget() ).isBetween( 0, 4096 );
+      duid_budget.fillDUIDInt( new BigUint64Array( 3 * 4096 ) );
+      test.number( duid_budget.getSequenceBudget() ).is( 0 );
+      test.number( duid_budget.getDriftMs() ).isGreaterThan( 0 );
+    } );
+
+    it( 'should stream unique hashids, one per line', function ( done ) {
+      var text = '';
+      duid_stream.createIDStream( { format: 'hashid', count: 10000, chunkSize: 1000 } ).on( 'data', function ( chunk ) {
+        text += chunk;
+      } ).on( 'end', function () {
+        var hashids = text.split( '\n' );
+        test.string( hashids.pop() ).is( '' );
+        test.array( hashids ).hasLength( 10000 );
+        test.bool( check_duplicates( hashids ) ).isTrue();
+        done();
+      } );
+    } );
+
+    it( 'should throw on unknown format', function () {
+      test.exception( function () {
+        duid_stream.createIDStream( { format: 'base64' } );
+      } ).isInstanceOf( TypeError );
+    } );
+
+  } );
+
+  describe( 'prefetch', function () {
+
+    var duid_prefetch = new init( 123, salt, epoch_start, { prefetch: { depth: 1024, lowWatermark: 256, maxAgeMs: 50 } } );
+
+    var id_of = function ( hashid ) {
+      return new BN( duid_prefetch.hashidDecode( hashid )[ 0 ], 10 );
+    };
+
+    it( 'should hand out unique, monotonic IDs within maxAgeMs of the clock across ring refills', function () {
+      var hashids = [];
+      var prev = new BN( 0 );
+      for ( var i = 0; i < 200; ++i ) {
+        var now_ms = new BN( duid_prefetch.getCurrentTimeMs(), 10 ).subn( epoch_start );
+        duid_prefetch.getDUID( 1 + ( i * 37 ) % 700 ).forEach( function ( hashid ) {
+          var id = id_of( hashid );
+          test.bool( id.cmp( prev ) === 1 ).isTrue();
+          test.bool( id.shrn( 22 ).addn( 50 ).gte( now_ms ) ).isTrue();
+          prev = id;
+          hashids.push( hashid );
+        } );
+      }
+      test.bool( check_duplicates( hashids ) ).isTrue();
+    } );
+
+    it( 'should skip IDs gone stale while idle', function ( done ) {
+      duid_prefetch.getDUID( 1 );
+      setTimeout( function () {
+        var now_ms = new BN( duid_prefetch.getCurrentTimeMs(), 10 ).subn( epoch_start );
+        test.bool( id_of( duid_prefetch.getDUID( 1 )[ 0 ] ).shrn( 22 ).addn( 50 ).gte( now_ms ) ).isTrue();
+        done();
+      }, 120 );
+    } );
+
+    it( 'should stay monotonic when getDUID is mixed with getDUIDInt and getDUIDBigInt', function () {
+      var prev = new BN( 0 );
+      var next = function ( id ) {
+        test.bool( id.cmp( prev ) === 1 ).isTrue();
+        prev = id;
+      };
+      for ( var i = 0; i < 100; ++i ) {
+        duid_prefetch.getDUID( 1 + i % 7 ).forEach( function ( hashid ) {
+          next( id_of( hashid ) );
+        } );
+        duid_prefetch.getDUIDInt( 1 + i % 3 ).forEach( function ( id ) {
+          next( new BN( id, 10 ) );
+        } );
+        next( new BN( duid_prefetch.getDUIDBigInt().toString(), 10 ) );
+      }
+    } );
+
+    it( 'should count IDs as issued when handed out, not when prefetched', function ( done ) {
+      var duid_counted = new init( 123, salt, epoch_start, { prefetch: true } );
+      setTimeout( function () {
+        duid_counted.getDUID( 10 );
+        duid_counted.getDUIDInt( 5 );
+        test.number( duid_counted.getStats().idsIssued ).is( 15 );
+        done();
+      }, 20 );
+    } );
+
+  } );
+
+  describe( 'argument and result conversion', function () {
+
+    var duid_conv = new init( 123, salt, epoch_start );
+
+    it( 'should return plain arrays of strings, empty for a count of 0', function () {
+      test.array( duid_conv.getDUIDInt( 0 ) ).is( [] );
+      test.array( duid_conv.getDUID( 0 ) ).is( [] );
+      test.array( duid_conv.getDUIDInt( 3 ) ).hasLength( 3 );
+      test.string( duid_conv.getDUIDInt( 1 )[ 0 ] ).match( /^\d+$/ );
+      test.array( duid_conv.getDUID( 8192 ) ).hasLength( 8192 );
+      test.array( duid_conv.hashidDecode( duid_conv.getDUID( 1 )[ 0 ] ) ).hasLength( 1 );
+      test.array( duid_conv.hashidDecode( 'not a hashid!' ) ).is( [] );
+    } );
+
+    it( 'should take numbers, BigInts and decimal strings alike', function () {
+      var hashid = duid_conv.hashidEncode( [ '12534941854212112', '123' ] );
+      test.string( duid_conv.hashidEncode( [ BigInt( '12534941854212112' ), 123 ] ) ).is( hashid );
+      test.array( duid_conv.hashidDecode( hashid ) ).is( [ '12534941854212112', '123' ] );
+      test.string( new init( 1, salt, BigInt( epoch_start ) ).getEpochStart() ).is( String( epoch_start ) );
+      test.string( new init( 1, salt, String( epoch_start ) ).getEpochStart() ).is( String( epoch_start ) );
+    } );
+
+  } );
+
   describe( 'DUID with drifting time', function () {
 
     var duid_instance3 = new init( 123, salt, epoch_start );
@@ -0,0 +1,472 @@
+/* libshortduid C API tests, run with ctest */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "libshortduid.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures; \
+    } \
+  } while (0)
+
+#define SALT "39622feb2b3e7aa7208f50f45ec36fd513baadad6977b53295a3b28aeaed4a54"
+#define EPOCH_START 1433116800000ULL
+
+static void test_settings(void) {
+  shortduid_t *duid = shortduid_new(1024 + 123, SALT, EPOCH_START);
+  CHECK(duid != NULL);
+  CHECK(shortduid_shard_id(duid) == 123);
+  CHECK(shortduid_epoch_start(duid) == EPOCH_START);
+  CHECK(shortduid_current_time_ms(duid) > EPOCH_START);
+  shortduid_free(duid);
+
+  duid = shortduid_new(0, NULL, (uint64_t)-1);
+  CHECK(shortduid_epoch_start(duid) == 0);
+  shortduid_free(duid);
+}
+
+static void test_ids(void) {
+  uint64_t ids[3 * 4096 + 7];
+  size_t i;
+  shortduid_t *duid = shortduid_new(123, SALT, EPOCH_START);
+
+  ids[0] = shortduid_next(duid);
+  shortduid_next_many(duid, ids + 1, sizeof(ids) / sizeof(ids[0]) - 1);
+  for (i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+    CHECK(((ids[i] >> 12) & 1023) == 123);
+    if (i > 0 && ids[i] <= ids[i - 1]) {
+      CHECK(ids[i] > ids[i - 1]);
+      break;
+    }
+  }
+  shortduid_free(duid);
+}
+
+static void test_layouts(void) {
+  static const uint32_t layouts[] = { SHORTDUID_LAYOUT_42_10_12, SHORTDUID_LAYOUT_41_8_15, SHORTDUID_LAYOUT_40_14_10 };
+  uint64_t ids[3 * 4096];
+  size_t l, i;
+
+  for (l = 0; l < sizeof(layouts) / sizeof(layouts[0]); ++l) {
+    unsigned shard_bits = (layouts[l] >> 8) & 0xff, sequence_bits = layouts[l] & 0xff;
+    uint64_t now, shard_mask = (1ULL << shard_bits) - 1;
+    shortduid_t *duid = shortduid_new_layout(0xffffffff, SALT, EPOCH_START, layouts[l]);
+    CHECK(duid != NULL);
+    CHECK(shortduid_layout(duid) == layouts[l]);
+    CHECK(shortduid_shard_id(duid) == shard_mask);
+
+    now = shortduid_current_time_ms(duid) - EPOCH_START;
+    shortduid_next_many(duid, ids, sizeof(ids) / sizeof(ids[0]));
+    CHECK((ids[0] >> (shard_bits + sequence_bits)) + 1 >= now && (ids[0] >> (shard_bits + sequence_bits)) <= now + 1);
+    for (i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+      CHECK(((ids[i] >> sequence_bits) & shard_mask) == shard_mask);
+      if (i > 0 && ids[i] <= ids[i - 1]) {
+        CHECK(ids[i] > ids[i - 1]);
+        break;
+      }
+    }
+    shortduid_free(duid);
+  }
+
+  CHECK(shortduid_new_layout(1, SALT, EPOCH_START, (42 << 16) | (11 << 8) | 12) == NULL);
+}
+
+static void test_parse(void) {
+  uint64_t ids[100], timestamp_ms = 0, now;
+  uint32_t shard_id = 0, sequence = 0;
+  size_t i;
+  shortduid_t *duid = shortduid_new(123, SALT, EPOCH_START);
+  shortduid_t *wide = shortduid_new_layout(200, SALT, EPOCH_START, SHORTDUID_LAYOUT_41_8_15);
+
+  now = shortduid_current_time_ms(duid);
+  shortduid_next_many(duid, ids, sizeof(ids) / sizeof(ids[0]));
+  for (i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+    shortduid_parse(duid, ids[i], &timestamp_ms, &shard_id, &sequence);
+    CHECK(timestamp_ms + 1 >= now && timestamp_ms <= now + 1 && shard_id == 123 && sequence == (ids[i] & 4095));
+    CHECK(shortduid_min_id_for_time(duid, timestamp_ms) <= ids[i] && ids[i] <= shortduid_max_id_for_time(duid, timestamp_ms));
+    CHECK(shortduid_max_id_for_time(duid, timestamp_ms - 1) < ids[i] && ids[i] < shortduid_min_id_for_time(duid, timestamp_ms + 1));
+  }
+  CHECK(shortduid_max_id_for_time(duid, now) + 1 == shortduid_min_id_for_time(duid, now + 1));
+  CHECK(shortduid_min_id_for_time(duid, 0) == 0);
+
+  shortduid_parse(wide, shortduid_next(wide), &timestamp_ms, &shard_id, NULL);
+  CHECK(timestamp_ms + 1 >= now && shard_id == 200);
+  CHECK(shortduid_min_id_for_time(wide, EPOCH_START + 1) == 1ULL << 23);
+  shortduid_free(wide);
+  shortduid_free(duid);
+}
+
+static void test_stats(void) {
+  uint64_t ids[3 * 4096];
+  shortduid_stats_t stats;
+  shortduid_t *duid = shortduid_new(1, SALT, EPOCH_START);
+
+  shortduid_next(duid);
+  shortduid_next_many(duid, ids, sizeof(ids) / sizeof(ids[0]));
+  shortduid_get_stats(duid, &stats, 1);
+  CHECK(stats.ids_issued == 1 + sizeof(ids) / sizeof(ids[0]));
+  CHECK(stats.sequence_overflows >= 2);
+  CHECK(stats.max_drift_ms >= 1);
+  CHECK(stats.clock_regressions == 0);
+
+  shortduid_get_stats(duid, &stats, 0);
+  CHECK(stats.ids_issued == 0 && stats.sequence_overflows == 0 && stats.max_drift_ms == 0);
+  shortduid_free(duid);
+}
+
+#define SHARED_THREADS 4
+#define SHARED_IDS (64 * 1024)
+
+static int compare_ids(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void *shared_worker(void *arg) {
+  uint64_t *ids = (uint64_t *)arg;
+  shortduid_t *duid = shortduid_new_shared(7, SALT, EPOCH_START);
+  size_t i;
+
+  for (i = 0; i < SHARED_IDS; i += 4) {
+    ids[i] = shortduid_next(duid);
+    shortduid_next_many(duid, ids + i + 1, 3);
+  }
+  shortduid_free(duid);
+  return NULL;
+}
+
+static void test_shared(void) {
+  uint64_t *ids = (uint64_t *)malloc(SHARED_THREADS * SHARED_IDS * sizeof(uint64_t));
+  shortduid_t *a = shortduid_new_shared(7, SALT, EPOCH_START);
+  shortduid_t *b = shortduid_new_shared(7, "other salt", EPOCH_START);
+  shortduid_stats_t stats;
+  size_t i, t;
+
+  /* Same shard and epoch, same generator */
+  shortduid_get_stats(a, &stats, 1);
+  shortduid_next(b);
+  shortduid_get_stats(a, &stats, 0);
+  CHECK(stats.ids_issued == 1);
+
+#ifndef _WIN32
+  {
+    pthread_t threads[SHARED_THREADS];
+    for (t = 0; t < SHARED_THREADS; ++t)
+      CHECK(pthread_create(&threads[t], NULL, shared_worker, ids + t * SHARED_IDS) == 0);
+    for (t = 0; t < SHARED_THREADS; ++t)
+      pthread_join(threads[t], NULL);
+  }
+#else
+  for (t = 0; t < SHARED_THREADS; ++t)
+    shared_worker(ids + t * SHARED_IDS);
+#endif
+
+  /* Monotonic within every thread, unique across all of them */
+  for (t = 0; t < SHARED_THREADS; ++t) {
+    for (i = 1; i < SHARED_IDS; ++i) {
+      if (ids[t * SHARED_IDS + i] <= ids[t * SHARED_IDS + i - 1]) {
+        CHECK(ids[t * SHARED_IDS + i] > ids[t * SHARED_IDS + i - 1]);
+        break;
+      }
+    }
+  }
+  qsort(ids, SHARED_THREADS * SHARED_IDS, sizeof(uint64_t), compare_ids);
+  for (i = 1; i < SHARED_THREADS * SHARED_IDS; ++i) {
+    if (ids[i] == ids[i - 1]) {
+      CHECK(ids[i] != ids[i - 1]);
+      break;
+    }
+  }
+  for (i = 0; i < SHARED_THREADS * SHARED_IDS; ++i)
+    CHECK(((ids[i] >> 12) & 1023) == 7);
+
+  shortduid_get_stats(a, &stats, 0);
+  CHECK(stats.ids_issued == 1 + SHARED_THREADS * SHARED_IDS);
+
+  shortduid_free(b);
+  shortduid_free(a);
+  free(ids);
+}
+
+#ifndef _WIN32
+#define SHM_NAME "/shortduid-test-core"
+
+static void test_shm(void) {
+  uint64_t *ids = (uint64_t *)malloc(2 * SHARED_IDS * sizeof(uint64_t));
+  shortduid_t *duid;
+  int fds[2];
+  pid_t child;
+  size_t i, got = 0;
+  ssize_t n;
+
+  shortduid_shm_unlink(SHM_NAME);
+  CHECK(pipe(fds) == 0);
+  child = fork();
+  if (child == 0) {
+    /* Child hands its IDs over through the pipe */
+    duid = shortduid_new_shm(9, SALT, EPOCH_START, SHM_NAME);
+    for (i = 0; duid && i < SHARED_IDS; i += 4) {
+      ids[i] = shortduid_next(duid);
+      shortduid_next_many(duid, ids + i + 1, 3);
+    }
+    if (duid && write(fds[1], ids, SHARED_IDS * sizeof(uint64_t)) != (ssize_t)(SHARED_IDS * sizeof(uint64_t)))
+      _exit(2);
+    _exit(duid ? 0 : 1);
+  }
+  close(fds[1]);
+
+  duid = shortduid_new_shm(9, SALT, EPOCH_START, SHM_NAME);
+  CHECK(duid != NULL);
+  for (i = 0; duid && i < SHARED_IDS; i += 4) {
+    ids[SHARED_IDS + i] = shortduid_next(duid);
+    shortduid_next_many(duid, ids + SHARED_IDS + i + 1, 3);
+  }
+  while ((n = read(fds[0], (char *)ids + got, SHARED_IDS * sizeof(uint64_t) - got)) > 0)
+    got += (size_t)n;
+  close(fds[0]);
+  {
+    int status = -1;
+    waitpid(child, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  CHECK(got == SHARED_IDS * sizeof(uint64_t));
+
+  /* Two processes, one shard, no duplicates */
+  qsort(ids, 2 * SHARED_IDS, sizeof(uint64_t), compare_ids);
+  for (i = 1; i < 2 * SHARED_IDS; ++i) {
+    if (ids[i] == ids[i - 1]) {
+      CHECK(ids[i] != ids[i - 1]);
+      break;
+    }
+  }
+
+  /* Segment remembers what it was set up for */
+  CHECK(shortduid_new_shm(10, SALT, EPOCH_START, SHM_NAME) == NULL);
+  CHECK(shortduid_new_shm(9, SALT, EPOCH_START + 1, SHM_NAME) == NULL);
+
+  shortduid_free(duid);
+  CHECK(shortduid_shm_unlink(SHM_NAME) == 1);
+  free(ids);
+}
+#endif
+
+#ifndef _WIN32
+#define HWM_PATH "shortduid-test.hwm"
+
+static void test_high_water_mark(void) {
+  uint64_t first, second;
+  shortduid_t *duid;
+
+  remove(HWM_PATH);
+  duid = shortduid_new(5, SALT, EPOCH_START);
+  CHECK(shortduid_enable_high_water_mark(duid, HWM_PATH, 60000) == 1);
+  CHECK(shortduid_enable_high_water_mark(duid, HWM_PATH, 60000) == 1);
+  CHECK(shortduid_enable_high_water_mark(duid, HWM_PATH ".other", 60000) == 0);
+  first = shortduid_next(duid);
+  shortduid_free(duid);
+
+  /* Restart resumes above everything reserved, clock has not got there yet */
+  duid = shortduid_new(5, SALT, EPOCH_START);
+  CHECK(shortduid_enable_high_water_mark(duid, HWM_PATH, 60000) == 1);
+  second = shortduid_next(duid);
+  CHECK((second >> 22) > (first >> 22) + 60000 - 1);
+  shortduid_free(duid);
+
+  duid = shortduid_new(6, SALT, EPOCH_START);
+  CHECK(shortduid_enable_high_water_mark(duid, HWM_PATH, 0) == 0);
+  shortduid_free(duid);
+  remove(HWM_PATH);
+}
+#endif
+
+static void test_time_sources(void) {
+  shortduid_t *duid = shortduid_new(4, SALT, EPOCH_START);
+  uint64_t ids[1000], steady, now;
+  int source;
+  size_t i;
+
+  CHECK(shortduid_set_time_source(duid, 42) == 0);
+  for (source = SHORTDUID_TIME_STEADY; source <= SHORTDUID_TIME_TICKER; ++source) {
+    steady = shortduid_current_time_ms(duid);
+    CHECK(shortduid_set_time_source(duid, source) == 1);
+    now = shortduid_current_time_ms(duid);
+    CHECK(now + 20 > steady && now < steady + 20); /* Coarse may be a tick behind */
+
+    /* Time has to keep moving */
+    while (shortduid_current_time_ms(duid) < now + 10)
+      ;
+    shortduid_next_many(duid, ids, sizeof(ids) / sizeof(ids[0]));
+    for (i = 1; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+      if (ids[i] <= ids[i - 1]) {
+        CHECK(ids[i] > ids[i - 1]);
+        break;
+      }
+    }
+  }
+
+#ifndef _WIN32
+  {
+    /* Forked child has no ticker thread, it must get one back */
+    pid_t child = fork();
+    int status = -1;
+    if (child == 0) {
+      now = shortduid_current_time_ms(duid);
+      while (shortduid_current_time_ms(duid) < now + 10)
+        ;
+      shortduid_free(duid); /* Stops and joins the new ticker */
+      _exit(0);
+    }
+    waitpid(child, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+#endif
+  shortduid_free(duid);
+}
+
+static void test_hashid(void) {
+  char hashid[64];
+  uint64_t number = 0;
+  size_t len;
+  shortduid_t *duid = shortduid_new(12, SALT, EPOCH_START);
+
+  CHECK(shortduid_hashid_max_length(duid) <= sizeof(hashid));
+  len = shortduid_hashid_encode(duid, 123456, hashid, sizeof(hashid));
+  CHECK(len == 5 && memcmp(hashid, "LeGxr", 5) == 0);
+  CHECK(shortduid_hashid_encode(duid, 123456, hashid, 2) == 0);
+
+  CHECK(shortduid_hashid_decode(duid, "LeGxr", 5, &number) == 1 && number == 123456);
+  CHECK(shortduid_hashid_decode(duid, "LeG!r", 5, &number) == 0);
+  CHECK(shortduid_hashid_decode(duid, "reG4QhO4NCpm", 12, &number) == 0); /* Three numbers */
+
+  len = shortduid_hashid_encode(duid, UINT64_MAX, hashid, sizeof(hashid));
+  CHECK(shortduid_hashid_decode(duid, hashid, len, &number) == 1 && number == UINT64_MAX);
+  shortduid_free(duid);
+}
+
+static void test_hashid_padding(void) {
+  char hashid[1024];
+  uint64_t number = 0;
+  size_t len, i;
+  shortduid_t *duid = shortduid_new_hashid(0, "this is my salt", 0, 8, NULL);
+
+  /* Same as the reference implementations */
+  len = shortduid_hashid_encode(duid, 1, hashid, sizeof(hashid));
+  CHECK(len == 8 && memcmp(hashid, "gB0NV05e", 8) == 0);
+  CHECK(shortduid_hashid_decode(duid, "gB0NV05e", 8, &number) == 1 && number == 1);
+  CHECK(shortduid_hashid_decode(duid, "B0NV05", 6, &number) == 0); /* Unpadded */
+  shortduid_free(duid);
+
+  duid = shortduid_new_hashid(0, "this is my salt", 0, 0, "0123456789abcdef");
+  len = shortduid_hashid_encode(duid, 1234567, hashid, sizeof(hashid));
+  CHECK(len == 7 && memcmp(hashid, "b332db5", 7) == 0);
+  shortduid_free(duid);
+
+  /* Many padding rounds, every hash exactly min_length long */
+  duid = shortduid_new_hashid(12, SALT, EPOCH_START, 1000, NULL);
+  CHECK(shortduid_hashid_max_length(duid) == 1000);
+  for (i = 0; i < 100; ++i) {
+    len = shortduid_hashid_encode(duid, shortduid_next(duid), hashid, sizeof(hashid));
+    CHECK(len == 1000);
+    CHECK(shortduid_hashid_decode(duid, hashid, len, &number) == 1);
+  }
+  shortduid_free(duid);
+
+  CHECK(shortduid_new_hashid(0, "", 0, 8, "0123456789abcde") == NULL);
+  CHECK(shortduid_new_hashid(0, "", 0, 8, "0123456789abcdee") == NULL);
+  CHECK(shortduid_new_hashid(0, "", 0, 8, "0123456789abcde f") == NULL);
+}
+
+static void test_sortable(void) {
+  char key[SHORTDUID_SORTABLE_WIDTH], previous[SHORTDUID_SORTABLE_WIDTH];
+  uint64_t ids[1000], id = 0;
+  size_t i;
+  shortduid_t *duid = shortduid_new(12, SALT, EPOCH_START);
+
+  /* Digits in ASCII order, zero padded */
+  shortduid_sortable_encode(duid, 0, key);
+  CHECK(memcmp(key, "00000000000", SHORTDUID_SORTABLE_WIDTH) == 0);
+  shortduid_sortable_encode(duid, 62, key);
+  CHECK(memcmp(key, "00000000010", SHORTDUID_SORTABLE_WIDTH) == 0);
+  shortduid_sortable_encode(duid, UINT64_MAX, key);
+  CHECK(memcmp(key, "LygHa16AHYF", SHORTDUID_SORTABLE_WIDTH) == 0);
+  CHECK(shortduid_sortable_decode(duid, "LygHa16AHYF", 11, &id) == 1 && id == UINT64_MAX);
+  CHECK(shortduid_sortable_decode(duid, "LygHa16AHYG", 11, &id) == 0); /* Above UINT64_MAX */
+  CHECK(shortduid_sortable_decode(duid, "0000000001-", 11, &id) == 0);
+  CHECK(shortduid_sortable_decode(duid, "0000000001", 10, &id) == 0);
+
+  /* Keys of IDs as they come sort like the IDs, with or without key */
+  shortduid_next_many(duid, ids, 1000);
+  for (i = 0; i < 1000; ++i) {
+    shortduid_sortable_encode(duid, ids[i], key);
+    CHECK(i == 0 || memcmp(previous, key, sizeof(key)) < 0);
+    CHECK(shortduid_sortable_decode(duid, key, sizeof(key), &id) == 1 && id == ids[i]);
+    memcpy(previous, key, sizeof(key));
+  }
+
+  CHECK(shortduid_set_sortable(duid, 2, NULL) == 0);
+  CHECK(shortduid_set_sortable(duid, SHORTDUID_SORTABLE_BASE64URL, "secret") == 1);
+  shortduid_sortable_encode(duid, 0xfffffffffffc0000ULL, key);
+  CHECK(shortduid_set_sortable(duid, SHORTDUID_SORTABLE_BASE64URL, NULL) == 1);
+  shortduid_sortable_encode(duid, 0xfffffffffffc0000ULL, previous);
+  CHECK(memcmp(previous, "Ezzzzzzz---", SHORTDUID_SORTABLE_WIDTH) == 0 && memcmp(key, previous, sizeof(key)) != 0);
+
+  /* With key only order within a millisecond is lost */
+  CHECK(shortduid_set_sortable(duid, SHORTDUID_SORTABLE_BASE64URL, "secret") == 1);
+  for (i = 0; i < 1000; ++i) {
+    shortduid_sortable_encode(duid, ids[i], key);
+    CHECK(i == 0 || (ids[i] >> 22) == (ids[i - 1] >> 22) || memcmp(previous, key, sizeof(key)) < 0);
+    CHECK(shortduid_sortable_decode(duid, key, sizeof(key), &id) == 1 && id == ids[i]);
+    memcpy(previous, key, sizeof(key));
+  }
+  CHECK(shortduid_sortable_decode(duid, "Fzzzzzzzzzz", 11, &id) == 0); /* Above 64 bits */
+  shortduid_free(duid);
+}
+
+static void test_random(void) {
+  char a[64], b[64];
+  size_t i;
+
+  CHECK(shortduid_random_string(a, sizeof(a), "ab") == sizeof(a));
+  for (i = 0; i < sizeof(a); ++i)
+    CHECK(a[i] == 'a' || a[i] == 'b');
+
+  CHECK(shortduid_random_string(a, sizeof(a), "0123456789abcdef") == sizeof(a));
+  CHECK(shortduid_random_string(b, sizeof(b), "0123456789abcdef") == sizeof(b));
+  CHECK(memcmp(a, b, sizeof(a)) != 0);
+  CHECK(shortduid_random_string(a, sizeof(a), "") == 0);
+}
+
+int main(void) {
+  test_settings();
+  test_ids();
+  test_layouts();
+  test_parse();
+  test_stats();
+  test_shared();
+#ifndef _WIN32
+  test_shm();
+#endif
+#ifndef _WIN32
+  test_high_water_mark();
+#endif
+  test_time_sources();
+  test_hashid();
+  test_hashid_padding();
+  test_sortable();
+  test_random();
+
+  if (failures)
+    fprintf(stderr, "%d check(s) failed\n", failures);
+  else
+    printf("libshortduid %s: all checks passed\n", shortduid_version());
+  return failures ? 1 : 0;
+}
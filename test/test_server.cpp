@@ -0,0 +1,308 @@
+// shortduid_server tests over loopback, run with ctest
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "generator.h"
+#include "hashids.h"
+#include "protocol.h"
+#include "server.h"
+
+using namespace shortduid;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures; \
+    } \
+  } while (0)
+
+#define SALT "39622feb2b3e7aa7208f50f45ec36fd513baadad6977b53295a3b28aeaed4a54"
+#define EPOCH_START 1433116800000ULL
+
+static int connect_tcp(uint16_t port) {
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int connect_unix(const std::string& path) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void send_all(int fd, const std::string& data) {
+  size_t pos = 0;
+  while (pos < data.size()) {
+    ssize_t sent = send(fd, data.data() + pos, data.size() - pos, 0);
+    if (sent <= 0) return;
+    pos += sent;
+  }
+}
+
+// Exactly len bytes, fewer only if the server closed the connection
+static std::string recv_exactly(int fd, size_t len) {
+  std::string data(len, '\0');
+  size_t pos = 0;
+  while (pos < len) {
+    ssize_t received = recv(fd, &data[pos], len - pos, 0);
+    if (received <= 0) break;
+    pos += received;
+  }
+  data.resize(pos);
+  return data;
+}
+
+static std::string request(uint8_t op, uint32_t tag, uint32_t count, uint8_t version = protocol::VERSION) {
+  unsigned char header[protocol::HEADER_SIZE];
+  protocol::PutHeader(header, { op, version, tag, count });
+  return std::string(reinterpret_cast<char*>(header), sizeof(header));
+}
+
+// Next response header and its payload
+static protocol::Header response(int fd, std::string* payload) {
+  std::string head = recv_exactly(fd, protocol::HEADER_SIZE);
+  protocol::Header header = { 0xff, 0xff, 0, 0 };
+  if (head.size() != protocol::HEADER_SIZE) return header;
+  header = protocol::GetHeader(reinterpret_cast<const unsigned char*>(head.data()));
+  *payload = recv_exactly(fd, header.count_or_length);
+  return header;
+}
+
+// HTTP response body, with the head checked for status and keep-alive
+static std::string http_get(int fd, const std::string& path, int status, const char* extra_header = "") {
+  send_all(fd, "GET " + path + " HTTP/1.1\r\nHost: test\r\n" + extra_header + "\r\n");
+  std::string head;
+  while (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0) {
+    std::string byte = recv_exactly(fd, 1);
+    if (byte.empty()) return "";
+    head += byte;
+  }
+  CHECK(head.compare(0, 12, "HTTP/1.1 " + std::to_string(status)) == 0);
+  size_t field = head.find("Content-Length: ");
+  CHECK(field != std::string::npos);
+  return recv_exactly(fd, std::stoul(head.substr(field + 16)));
+}
+
+static void test_binary(uint16_t port, const hashidsxx::Hashids& hash) {
+  int fd = connect_tcp(port);
+  CHECK(fd >= 0);
+
+  // Pipelined: everything sent up front, answered in order with tags echoed
+  std::string requests;
+  const uint32_t counts[] = { 1, 4096, 0, 65536, 3, 7 };
+  const uint8_t ops[] = { protocol::OP_INT, protocol::OP_INT, protocol::OP_PING, protocol::OP_INT, protocol::OP_HASHID, protocol::OP_INT };
+  for (uint32_t i = 0; i < 6; ++i) requests += request(ops[i], 100 + i, counts[i]);
+  send_all(fd, requests);
+
+  std::vector<uint64_t> ids;
+  for (uint32_t i = 0; i < 6; ++i) {
+    std::string payload;
+    protocol::Header header = response(fd, &payload);
+    CHECK(header.op == ops[i]);
+    CHECK(header.version_or_status == protocol::STATUS_OK);
+    CHECK(header.tag == 100 + i);
+    CHECK(header.count_or_length == payload.size());
+    if (ops[i] == protocol::OP_INT) {
+      CHECK(payload.size() == counts[i] * 8);
+      for (uint32_t j = 0; j < counts[i]; ++j) ids.push_back(protocol::GetU64(reinterpret_cast<const unsigned char*>(payload.data()) + j * 8));
+    } else if (ops[i] == protocol::OP_HASHID) {
+      size_t start = 0, lines = 0;
+      for (size_t end; (end = payload.find('\n', start)) != std::string::npos; start = end + 1, ++lines) {
+        uint64_t id = 0;
+        CHECK(hash.decode_one(payload.data() + start, end - start, id));
+        ids.push_back(id);
+      }
+      CHECK(lines == counts[i]);
+      CHECK(start == payload.size());
+    } else {
+      CHECK(payload.empty());
+    }
+  }
+
+  // Ascending across requests, so unique, and from shard 123
+  CHECK(ids.size() == 1 + 4096 + 65536 + 3 + 7);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    CHECK(((ids[i] >> 12) & 1023) == 123);
+    if (i > 0 && ids[i] <= ids[i - 1]) {
+      CHECK(ids[i] > ids[i - 1]);
+      break;
+    }
+  }
+
+  // Too many is answered without payload, the connection stays usable
+  std::string payload;
+  send_all(fd, request(protocol::OP_INT, 7, protocol::MAX_COUNT + 1) + request(protocol::OP_PING, 8, 0));
+  protocol::Header header = response(fd, &payload);
+  CHECK(header.version_or_status == protocol::STATUS_TOO_MANY && header.tag == 7 && payload.empty());
+  header = response(fd, &payload);
+  CHECK(header.version_or_status == protocol::STATUS_OK && header.tag == 8);
+
+  // Requests split across writes
+  std::string split = request(protocol::OP_INT, 9, 2);
+  send_all(fd, split.substr(0, 5));
+  usleep(10000);
+  send_all(fd, split.substr(5));
+  header = response(fd, &payload);
+  CHECK(header.tag == 9 && payload.size() == 16);
+
+  // Unknown op: bad request, then the server hangs up
+  send_all(fd, request(9, 10, 1));
+  header = response(fd, &payload);
+  CHECK(header.version_or_status == protocol::STATUS_BAD_REQUEST && header.tag == 10);
+  CHECK(recv_exactly(fd, 1).empty());
+  close(fd);
+
+  // Unknown version as well
+  fd = connect_tcp(port);
+  send_all(fd, request(protocol::OP_INT, 11, 1, protocol::VERSION + 1));
+  header = response(fd, &payload);
+  CHECK(header.version_or_status == protocol::STATUS_BAD_REQUEST && header.tag == 11);
+  close(fd);
+}
+
+static void test_http(uint16_t port, const hashidsxx::Hashids& hash) {
+  int fd = connect_tcp(port);
+  CHECK(fd >= 0);
+
+  // Keep-alive: every request on the same connection
+  CHECK(http_get(fd, "/", 200) == "{\"name\":\"ShortDUID API\"}");
+  std::string body = http_get(fd, "/nduid/3", 200);
+  CHECK(body.size() > 2 && body[0] == '[' && body[body.size() - 1] == ']');
+  CHECK(std::count(body.begin(), body.end(), ',') == 2);
+
+  body = http_get(fd, "/duid", 200);
+  CHECK(body.size() > 4 && body.compare(0, 2, "[\"") == 0);
+  uint64_t id = 0;
+  CHECK(hash.decode_one(body.data() + 2, body.size() - 4, id));
+  CHECK(((id >> 12) & 1023) == 123);
+
+  // Above the limit reads as 1, as in getDUID
+  body = http_get(fd, "/duid/8193", 200);
+  CHECK(std::count(body.begin(), body.end(), ',') == 0);
+  body = http_get(fd, "/duid/8192", 200);
+  CHECK(std::count(body.begin(), body.end(), ',') == 8191);
+
+  // Pipelined request line that is not a GET, shorter than "GET " even: bad request, then the server hangs up
+  send_all(fd, "GET / HTTP/1.1\r\n\r\n\r\n\r\n");
+  std::string answers;
+  for (std::string chunk; !(chunk = recv_exactly(fd, 1)).empty();) answers += chunk;
+  CHECK(answers.compare(0, 12, "HTTP/1.1 200") == 0);
+  CHECK(answers.find("HTTP/1.1 400") != std::string::npos);
+  close(fd);
+  fd = connect_tcp(port);
+
+  http_get(fd, "/nope", 404);
+  http_get(fd, "/", 200, "Connection: close\r\n");
+  CHECK(recv_exactly(fd, 1).empty());
+  close(fd);
+}
+
+static void test_backpressure(uint16_t port) {
+  // Requests sent without reading any response: the server stops taking them once its buffers are full, long before
+  // all of them are in, and still serves everyone else
+  const size_t total = 64 * 1024 * 1024 / protocol::HEADER_SIZE;
+  std::string requests;
+  requests.reserve(total * protocol::HEADER_SIZE);
+  for (uint32_t i = 0; i < total; ++i) requests += request(protocol::OP_PING, i, 0);
+
+  int fd = connect_tcp(port);
+  CHECK(fd >= 0);
+  timeval timeout = { 0, 200000 };
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  size_t pos = 0;
+  while (pos < requests.size()) {
+    ssize_t sent = send(fd, requests.data() + pos, requests.size() - pos, 0);
+    if (sent <= 0) break;
+    pos += sent;
+  }
+  CHECK(pos < requests.size());
+
+  int other = connect_tcp(port);
+  std::string payload;
+  send_all(other, request(protocol::OP_INT, 1, 1));
+  protocol::Header header = response(other, &payload);
+  CHECK(header.version_or_status == protocol::STATUS_OK && payload.size() == 8);
+  close(other);
+
+  // Whole requests that got through are all answered, in order
+  size_t answered = pos / protocol::HEADER_SIZE;
+  std::string responses = recv_exactly(fd, answered * protocol::HEADER_SIZE);
+  CHECK(responses.size() == answered * protocol::HEADER_SIZE);
+  for (size_t i = 0; i < responses.size() / protocol::HEADER_SIZE; ++i) {
+    header = protocol::GetHeader(reinterpret_cast<const unsigned char*>(responses.data()) + i * protocol::HEADER_SIZE);
+    if (header.tag != i || header.version_or_status != protocol::STATUS_OK) {
+      CHECK(header.tag == i && header.version_or_status == protocol::STATUS_OK);
+      break;
+    }
+  }
+  close(fd);
+}
+
+static void test_unix(const std::string& path) {
+  int fd = connect_unix(path);
+  CHECK(fd >= 0);
+  std::string payload;
+  send_all(fd, request(protocol::OP_INT, 1, 5));
+  protocol::Header header = response(fd, &payload);
+  CHECK(header.version_or_status == protocol::STATUS_OK && payload.size() == 40);
+  close(fd);
+}
+
+int main(void) {
+  hashidsxx::Hashids hash(SALT, 0, DEFAULT_ALPHABET);
+  std::string unix_path = "/tmp/shortduid_server_test." + std::to_string(getpid()) + ".sock";
+  uint16_t port = 0;
+  {
+    Server server(std::make_shared<Generator>(123, EPOCH_START), hash);
+    port = server.ListenTcp("127.0.0.1", 0);
+    CHECK(port != 0);
+    server.ListenUnix(unix_path);
+    std::thread thread([&]() { server.Run(); });
+
+    test_binary(port, hash);
+    test_http(port, hash);
+    test_backpressure(port);
+    test_unix(unix_path);
+
+    server.Stop();
+    thread.join();
+  }
+  CHECK(access(unix_path.c_str(), F_OK) != 0);
+  CHECK(connect_tcp(port) < 0);
+
+  if (failures)
+    fprintf(stderr, "%d check(s) failed\n", failures);
+  else
+    printf("shortduid_server: all checks passed\n");
+  return failures ? 1 : 0;
+}